@@ -0,0 +1,71 @@
+// AIScheduler.cpp
+#include "AIScheduler.hpp"
+#include <algorithm>
+
+void AIScheduler::rebuild(const std::vector<Entity*> &enemies, Entity *player) {
+    for (std::vector<int> &bucket : m_wheel) bucket.clear();
+    m_overdue.clear();
+    m_enemies     = &enemies;
+    m_enemy_count = (int) enemies.size();
+    m_stale       = false;
+    
+    std::vector<int> overdue;
+    for (int i = 0; i < (int) enemies.size(); i++) {
+        Entity *enemy = enemies[i];
+        if (enemy == player or not enemy->has_ai_decisions()) continue;
+        
+        enemy->set_ai_clock(&m_step);
+        // Anything further out than a decision could have put it came from elsewhere
+        int due = std::min(enemy->get_ai_due(), m_step + MAX_INTERVAL);
+        enemy->set_ai_due(due);
+        if (due <= m_step) overdue.push_back(i);
+        else enqueue(i, due);
+    }
+    std::sort(overdue.begin(), overdue.end(), [&enemies] (int a, int b) {
+        int due_a = enemies[a]->get_ai_due(),
+            due_b = enemies[b]->get_ai_due();
+        return due_a != due_b ? due_a < due_b : a < b;
+    });
+    m_overdue.assign(overdue.begin(), overdue.end());
+}
+
+void AIScheduler::schedule(const std::vector<Entity*> &enemies, Entity *player) {
+    if (m_stale or &enemies != m_enemies or (int) enemies.size() != m_enemy_count)
+        rebuild(enemies, player);
+    
+    m_stats.steps++;
+    m_step++;
+    
+    // Everyone in this step's bucket is due now, which is later than anything
+    // already overdue, so they go on the end in index order
+    std::vector<int> &bucket = m_wheel[m_step % WHEEL_SIZE];
+    std::sort(bucket.begin(), bucket.end());
+    m_overdue.insert(m_overdue.end(), bucket.begin(), bucket.end());
+    bucket.clear();
+    m_stats.peak_due = std::max(m_stats.peak_due, (int) m_overdue.size());
+    
+    // Only the most overdue get a go; the rest stay at the front for next step
+    int decisions = 0;
+    while (decisions < m_budget and not m_overdue.empty()) {
+        int index = m_overdue.front();
+        m_overdue.pop_front();
+        Entity *enemy = enemies[index];
+        
+        // Killed off for now; look again in a while rather than every step
+        if (not enemy->get_active_state()) {
+            enemy->set_ai_due(m_step + MAX_INTERVAL);
+            enqueue(index, m_step + MAX_INTERVAL);
+            continue;
+        }
+        
+        float player_distance = enemy->ai_decide(player);
+        float t = (player_distance - NEAR_DISTANCE) / (FAR_DISTANCE - NEAR_DISTANCE);
+        t = std::min(1.0f, std::max(0.0f, t));
+        int due = m_step + 1 + (int) (t * (MAX_INTERVAL - 1));
+        enemy->set_ai_due(due);
+        enqueue(index, due);
+        decisions++;
+    }
+    m_stats.decisions += decisions;
+    m_stats.deferred  += (int) m_overdue.size();
+}
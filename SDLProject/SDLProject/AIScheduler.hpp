@@ -0,0 +1,78 @@
+#ifndef AISCHEDULER_H
+#define AISCHEDULER_H
+
+#pragma once
+#include <SDL.h>
+#include <vector>
+#include <deque>
+#include "Entity.hpp"
+
+struct AIStats {
+    int     steps       = 0,
+            decisions   = 0,
+            deferred    = 0,    // due, but pushed to a later step by the budget
+            peak_due    = 0;
+};
+
+// Spreads the enemies' decisions (Entity::ai_decide) out over fixed steps, while
+// their steering still runs in every update. An enemy near the player decides
+// every step; further away it waits longer, up to MAX_INTERVAL steps. At most
+// budget decisions are made in a step, most overdue first.
+//
+// Enemies sit in a wheel of buckets by the step they're next due, so a step only
+// looks at the ones due in it (plus any the budget held back); the rest aren't
+// touched at all, so a step costs about the same with 16k enemies as with 1k (see
+// ai_scheduled in the benchmarks). Bear in mind that's partly because it makes
+// fewer decisions: past the budget, the far ones just end up further overdue.
+//
+// The budget is a count of decisions rather than microseconds: a budget measured
+// on the clock would make different choices on different runs, and replays,
+// rewinding and rollback all need every step to come out the same. Each enemy
+// keeps its next due step on this scheduler's clock, and saves it as a countdown
+// in its EntityState; after a load (reschedule()) the buckets are rebuilt from
+// those, in the same order the wheel would have had them.
+class AIScheduler {
+public:
+    static constexpr int    DEFAULT_BUDGET  = 32,   // decisions per step
+                            MAX_INTERVAL    = 15;   // steps between decisions at FAR_DISTANCE
+    static constexpr float  NEAR_DISTANCE   = 3.0f, // guards notice the player inside this
+                            FAR_DISTANCE    = 15.0f;
+
+private:
+    static constexpr int WHEEL_SIZE = MAX_INTERVAL + 1;
+    
+    int m_budget = DEFAULT_BUDGET,
+        m_step   = 0;                           // the clock the enemies' due steps are on
+    
+    // Indices into the enemy list. A bucket holds everyone due at a step (mod the
+    // wheel size); the overdue ones are kept in (due step, index) order
+    std::vector<int> m_wheel[WHEEL_SIZE];
+    std::deque<int>  m_overdue;
+    
+    const std::vector<Entity*> *m_enemies = nullptr;
+    int  m_enemy_count = 0;
+    bool m_stale = true;
+    AIStats m_stats;
+    
+    void rebuild(const std::vector<Entity*> &enemies, Entity *player);
+    void enqueue(int index, int due) { m_wheel[due % WHEEL_SIZE].push_back(index); }
+
+public:
+    AIScheduler() = default;
+    // The enemies hold on to m_step
+    AIScheduler(const AIScheduler&) = delete;
+    AIScheduler &operator=(const AIScheduler&) = delete;
+    
+    void set_budget(int decisions_per_step) { m_budget = decisions_per_step > 0 ? decisions_per_step : 1; }
+    int const get_budget() const { return m_budget; }
+
+    // Before the enemies update: makes the decisions that are due, up to the
+    // budget. Enemies it takes on stop deciding for themselves
+    void schedule(const std::vector<Entity*> &enemies, Entity *player);
+    // The enemies' countdowns were loaded from a saved state, so the buckets are out of date
+    void reschedule() { m_stale = true; }
+
+    AIStats const get_stats() const { return m_stats; }
+};
+
+#endif // AISCHEDULER_H
@@ -0,0 +1,356 @@
+// AssetLoader.cpp
+#define LOG(argument) std::cout << argument << '\n'
+
+#include "AssetLoader.hpp"
+#include "Utility.hpp"
+#include "Renderer.hpp"
+#include "Profiler.hpp"
+#include "TextureAtlas.hpp"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <map>
+#include <memory>
+#include <set>
+#include <iostream>
+#include <cassert>
+
+namespace {
+    typedef std::function<void()> Task;
+
+    /* ----- WORKERS ----- */
+    std::vector<std::thread> g_workers;
+    std::deque<Task> g_jobs;
+    std::mutex g_job_mutex;
+    std::condition_variable g_job_ready;
+    bool g_stopping = false;
+
+    /* ----- MAIN-THREAD UPLOAD QUEUE ----- */
+    std::deque<Task> g_uploads;
+    std::mutex g_upload_mutex;
+
+    std::thread::id g_main_thread;
+
+    std::atomic<int> g_requested(0),
+                     g_completed(0);
+
+    // Only ever touched on the main thread, from the requests and the uploads
+    template <typename T>
+    struct Cache {
+        std::map<std::string, T> loaded;
+        std::map<std::string, std::vector<T*>> waiting;
+    };
+
+    Cache<GLuint>       g_textures;
+    Cache<Sound*>       g_sounds;
+    Cache<Music*>       g_music;
+    
+    // Textures that will arrive with an atlas page rather than on their own
+    std::set<std::string> g_atlas_members;
+    std::vector<GLuint>   g_atlas_pages;
+
+    void worker_loop(int index) {
+        PROFILE_THREAD("Asset worker " + std::to_string(index));
+        
+        while (true) {
+            Task job;
+            {
+                std::unique_lock<std::mutex> lock(g_job_mutex);
+                g_job_ready.wait(lock, [] { return g_stopping or not g_jobs.empty(); });
+                if (g_jobs.empty()) return;
+                job = std::move(g_jobs.front());
+                g_jobs.pop_front();
+            }
+            PROFILE_SCOPE("asset job");
+            job();
+        }
+    }
+
+    void push_job(Task job) {
+        // Without workers (start() never called) we just do the work right here
+        if (g_workers.empty()) {
+            job();
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(g_job_mutex);
+            g_jobs.push_back(std::move(job));
+        }
+        g_job_ready.notify_one();
+    }
+
+    void push_upload(Task upload) {
+        std::lock_guard<std::mutex> lock(g_upload_mutex);
+        g_uploads.push_back(std::move(upload));
+    }
+
+    // Returns true if nobody has asked for this file yet, i.e. it needs loading
+    template <typename T>
+    bool use_cache(Cache<T> &cache, const std::string &key, T *out) {
+        auto loaded = cache.loaded.find(key);
+        if (loaded != cache.loaded.end()) {
+            *out = loaded->second;
+            return false;
+        }
+        std::vector<T*> &waiting = cache.waiting[key];
+        waiting.push_back(out);
+        return waiting.size() == 1;
+    }
+
+    template <typename T>
+    void resolve(Cache<T> &cache, const std::string &key, T value) {
+        cache.loaded[key] = value;
+        for (T *out : cache.waiting[key]) *out = value;
+        cache.waiting.erase(key);
+    }
+}
+
+void AssetLoader::start(int worker_count) {
+    if (not g_workers.empty()) return;
+
+    if (worker_count <= 0) worker_count = SDL_GetCPUCount() - 1;
+    if (worker_count < 1) worker_count = 1;
+
+    g_main_thread = std::this_thread::get_id();
+    g_stopping = false;
+    for (int i = 0; i < worker_count; i++)
+        g_workers.push_back(std::thread(worker_loop, i));
+
+    LOG("Asset loader started with " << worker_count << " worker(s).");
+}
+
+void AssetLoader::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(g_job_mutex);
+        g_stopping = true;
+    }
+    g_job_ready.notify_all();
+    for (std::thread &worker : g_workers) worker.join();
+    g_workers.clear();
+
+    // Anything still sitting in the queue was decoded for nothing; run it so
+    // nothing leaks, then release everything the loader owns
+    while (pump_uploads(1000.0f) > 0) { }
+
+    for (auto &texture : g_textures.loaded) Renderer::get()->delete_texture(texture.second);
+    for (GLuint page : g_atlas_pages)       Renderer::get()->delete_texture(page);
+    g_atlas_pages.clear();
+    for (auto &sound : g_sounds.loaded)     Audio::get()->free_sound(sound.second);
+    for (auto &music : g_music.loaded)      Audio::get()->free_music(music.second);
+    g_textures.loaded.clear();
+    g_sounds.loaded.clear();
+    g_music.loaded.clear();
+}
+
+void AssetLoader::request_texture(const char *filepath, GLuint *texture_id) {
+    std::string key = filepath;
+    if (not use_cache(g_textures, key, texture_id)) return;
+    
+    // The atlas resolves it along with everything else on the page
+    if (g_atlas_members.count(key)) return;
+
+    // Without a GL context there's nothing to decode the pixels for
+    if (Renderer::get()->is_headless()) {
+        resolve(g_textures, key, Renderer::get()->upload_texture(nullptr, 0, 0));
+        return;
+    }
+
+    g_requested++;
+    push_job([key] {
+        int width = 0, height = 0;
+        unsigned char *pixels = Utility::decode_texture(key.c_str(), &width, &height);
+
+        push_upload([key, pixels, width, height] {
+            if (not pixels) {
+                LOG("Unable to load image " << key << ". Make sure the path is correct.");
+                assert(false);
+            }
+            GLuint id = Utility::upload_texture(pixels, width, height);
+            Utility::free_texture_pixels(pixels);
+
+            resolve(g_textures, key, id);
+            g_completed++;
+        });
+    });
+}
+
+void AssetLoader::request_sound(const char *filepath, Sound **sound) {
+    std::string key = filepath;
+    if (not use_cache(g_sounds, key, sound)) return;
+
+    if (Audio::get()->is_null()) {
+        resolve(g_sounds, key, (Sound*) nullptr);
+        return;
+    }
+
+    g_requested++;
+    push_job([key] {
+        // Decoding and converting to the device format is the slow part
+        Sound *loaded = Audio::get()->load_sound(key.c_str());
+        if (not loaded) LOG("Unable to load sound " << key << ".");
+
+        push_upload([key, loaded] {
+            resolve(g_sounds, key, loaded);
+            g_completed++;
+        });
+    });
+}
+
+void AssetLoader::request_music(const char *filepath, Music **music) {
+    std::string key = filepath;
+    if (not use_cache(g_music, key, music)) return;
+
+    if (Audio::get()->is_null()) {
+        resolve(g_music, key, (Music*) nullptr);
+        return;
+    }
+
+    g_requested++;
+    push_job([key] {
+        Music *loaded = Audio::get()->load_music(key.c_str());
+        if (not loaded) LOG("Unable to load music " << key << ".");
+
+        push_upload([key, loaded] {
+            resolve(g_music, key, loaded);
+            g_completed++;
+        });
+    });
+}
+
+void AssetLoader::request_atlas(const std::vector<std::string> &filepaths) {
+    if (Renderer::get()->is_headless()) {
+        for (const std::string &key : filepaths)
+            resolve(g_textures, key, Renderer::get()->upload_texture(nullptr, 0, 0));
+        return;
+    }
+    
+    for (const std::string &key : filepaths) g_atlas_members.insert(key);
+    
+    // Each sheet decodes as its own job, so they spread over the workers; whichever
+    // finishes last packs the page
+    struct Build {
+        std::vector<TextureAtlas::Image> images;
+        std::atomic<int> remaining;
+    };
+    std::shared_ptr<Build> build = std::make_shared<Build>();
+    build->remaining = (int) filepaths.size();
+    for (const std::string &key : filepaths) build->images.push_back({ key, 0, 0, nullptr });
+    
+    g_requested += (int) filepaths.size();
+    for (int member = 0; member < (int) filepaths.size(); member++) push_job([build, member] {
+        TextureAtlas::Image &image = build->images[member];
+        image.pixels = Utility::decode_texture(image.name.c_str(), &image.width, &image.height);
+        if (not image.pixels) {
+            LOG("Unable to load image " << image.name << ". Make sure the path is correct.");
+            assert(false);
+        }
+        if (--build->remaining > 0) {
+            push_upload([] { g_completed++; });
+            return;
+        }
+        
+        // Anything that didn't decode stays off the page and comes back as texture 0
+        std::vector<TextureAtlas::Image> images;
+        std::vector<std::string> failed;
+        for (const TextureAtlas::Image &image : build->images) {
+            if (image.pixels) images.push_back(image);
+            else failed.push_back(image.name);
+        }
+        
+        std::vector<TextureAtlas::Rect> rects;
+        int page_size = 0;
+        bool packed = not images.empty() and TextureAtlas::pack(images, rects, &page_size);
+        unsigned char *page = packed ? TextureAtlas::compose(images, rects, page_size) : nullptr;
+        
+        push_upload([images, failed, rects, page, page_size] {
+            if (page) {
+                GLuint page_id = Utility::upload_texture(page, page_size, page_size);
+                delete [] page;
+                g_atlas_pages.push_back(page_id);
+                
+                for (int i = 0; i < (int) images.size(); i++) {
+                    const TextureAtlas::Rect &rect = rects[i];
+                    resolve(g_textures, images[i].name,
+                            Renderer::get()->create_region(page_id, rect.x, rect.y,
+                                                           rect.width, rect.height, page_size));
+                }
+                LOG("Packed " << images.size() << " textures into a " << page_size << "x"
+                    << page_size << " atlas.");
+            }
+            else if (not images.empty()) {
+                // Too big for one page, so they each get their own texture after all
+                LOG("Atlas didn't fit in " << TextureAtlas::MAX_PAGE_SIZE << "px, uploading separately.");
+                for (const TextureAtlas::Image &image : images)
+                    resolve(g_textures, image.name,
+                            Utility::upload_texture(image.pixels, image.width, image.height));
+            }
+            
+            for (const TextureAtlas::Image &image : images) {
+                g_atlas_members.erase(image.name);
+                Utility::free_texture_pixels((unsigned char*) image.pixels);
+            }
+            for (const std::string &name : failed) {
+                g_atlas_members.erase(name);
+                resolve(g_textures, name, (GLuint) 0);
+            }
+            g_completed++;
+        });
+    });
+}
+
+void AssetLoader::run_job(std::function<void()> work, std::function<void()> on_done) {
+    g_requested++;
+    push_job([work, on_done] {
+        work();
+
+        push_upload([on_done] {
+            if (on_done) on_done();
+            g_completed++;
+        });
+    });
+}
+
+int AssetLoader::pump_uploads(float budget_ms) {
+    Uint64 start  = SDL_GetPerformanceCounter();
+    Uint64 budget = (Uint64) (budget_ms / 1000.0f * SDL_GetPerformanceFrequency());
+
+    // Always run at least one upload, so a tiny budget can't stall loading
+    PROFILE_SCOPE("AssetLoader::pump_uploads");
+    int count = 0;
+    while (true) {
+        Task upload;
+        {
+            std::lock_guard<std::mutex> lock(g_upload_mutex);
+            if (g_uploads.empty()) break;
+            upload = std::move(g_uploads.front());
+            g_uploads.pop_front();
+        }
+        upload();
+        count++;
+
+        if (SDL_GetPerformanceCounter() - start >= budget) break;
+    }
+    return count;
+}
+
+void AssetLoader::finish() {
+    while (not is_done())
+        if (pump_uploads() == 0) SDL_Delay(1);
+}
+
+bool AssetLoader::is_main_thread() { return std::this_thread::get_id() == g_main_thread; }
+
+bool AssetLoader::is_done() { return g_completed.load() == g_requested.load(); }
+
+float AssetLoader::get_progress() {
+    int requested = g_requested.load();
+    if (requested == 0) return 1.0f;
+    return (float) g_completed.load() / (float) requested;
+}
+
+int AssetLoader::get_requested_count() { return g_requested.load(); }
+int AssetLoader::get_completed_count() { return g_completed.load(); }
+int AssetLoader::get_worker_count()    { return (int) g_workers.size(); }
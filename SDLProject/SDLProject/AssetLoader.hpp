@@ -0,0 +1,59 @@
+#ifndef ASSETLOADER_H
+#define ASSETLOADER_H
+
+#pragma once
+#define GL_SILENCE_DEPRECATION
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <string>
+#include <vector>
+#include <functional>
+#include <SDL.h>
+#include <SDL_opengl.h>
+#include "Audio.hpp"
+
+// Decodes and parses assets on worker threads, then hands the finished results
+// back to the main thread, which owns the GL context, through an upload queue.
+// Every request writes its result into the pointer it was given once it has been
+// uploaded, so callers just hold on to the GLuint / Sound* like before.
+// Assets are cached by path and owned by the loader, so scenes sharing a file
+// share the one copy and must not free it themselves.
+class AssetLoader {
+public:
+    static constexpr float DEFAULT_UPLOAD_BUDGET_MS = 4.0f;
+
+    // worker_count <= 0 uses one worker per core, minus the main thread
+    static void start(int worker_count = 0);
+    static void shutdown();
+
+    /* ----- REQUESTS (main thread only) ----- */
+    static void request_texture(const char *filepath, GLuint *texture_id);
+    static void request_sound(const char *filepath, Sound **sound);
+    static void request_music(const char *filepath, Music **music);
+    // Packs these images into one texture page. Call before anything asks for
+    // them; request_texture on any of them then hands back its region of the page
+    static void request_atlas(const std::vector<std::string> &filepaths);
+    // Runs work on a worker; on_done (if any) runs on the main thread afterwards
+    static void run_job(std::function<void()> work, std::function<void()> on_done = nullptr);
+
+    /* ----- MAIN-THREAD UPLOADS ----- */
+    // Runs finished uploads until the budget is used up; returns how many ran
+    static int pump_uploads(float budget_ms = DEFAULT_UPLOAD_BUDGET_MS);
+    // Blocks until every outstanding request has been uploaded
+    static void finish();
+    // The thread that called start(), and so the one that owns the uploads
+    static bool is_main_thread();
+
+    /* ----- PROGRESS ----- */
+    static bool  is_done();
+    static float get_progress();
+    static int   get_requested_count();
+    static int   get_completed_count();
+    static int   get_worker_count();
+};
+
+#endif // ASSETLOADER_H
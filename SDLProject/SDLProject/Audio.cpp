@@ -0,0 +1,6 @@
+// Audio.cpp
+#include "Audio.hpp"
+
+// The backends live in their own files (MixerAudio.cpp, SoftwareMixer.cpp), so a
+// headless build can leave them out
+Audio *Audio::s_active = nullptr;
@@ -0,0 +1,94 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#pragma once
+#include <SDL.h>
+
+// Backend-specific sound data lives in subclasses of these; scenes just hold the pointers
+class Sound {
+public:
+    virtual ~Sound() {}
+};
+
+class Music {
+public:
+    virtual ~Music() {}
+};
+
+// Like Renderer, this keeps SDL_mixer out of the game code, so the NullAudio
+// backend can stand in when there's no audio device (or no need for one).
+class Audio {
+public:
+    virtual ~Audio() {}
+
+    virtual bool open() = 0;
+    virtual void close() = 0;
+
+    // Loading may run on the asset loader's workers
+    virtual Sound *load_sound(const char *filepath) = 0;
+    virtual Music *load_music(const char *filepath) = 0;
+    virtual void free_sound(Sound *sound) { delete sound; }
+    virtual void free_music(Music *music) { delete music; }
+
+    // Sounds play on a fixed set of voices; which voice is up to the caller (see AudioManager)
+    virtual void set_voice_count(int count) = 0;
+    virtual void play_sound(Sound *sound, int voice, float volume) = 0;
+    virtual void stop_voice(int voice) = 0;
+    virtual bool const is_voice_playing(int voice) const = 0;
+
+    virtual void play_music(Music *music, int loops) = 0;
+    virtual void set_music_volume(float volume) = 0;  // 0 to 1
+
+    virtual bool const is_null() const { return false; }
+
+    static Audio *get() { return s_active; }
+    static void set(Audio *audio) { s_active = audio; }
+
+private:
+    static Audio *s_active;
+};
+
+class MixerAudio : public Audio {
+private:
+    int m_frequency,
+        m_channels,
+        m_buffer_size;
+
+public:
+    MixerAudio(int frequency, int channels, int buffer_size) :
+    m_frequency(frequency), m_channels(channels), m_buffer_size(buffer_size) {}
+
+    bool open() override;
+    void close() override;
+
+    Sound *load_sound(const char *filepath) override;
+    Music *load_music(const char *filepath) override;
+
+    void set_voice_count(int count) override;
+    void play_sound(Sound *sound, int voice, float volume) override;
+    void stop_voice(int voice) override;
+    bool const is_voice_playing(int voice) const override;
+
+    void play_music(Music *music, int loops) override;
+    void set_music_volume(float volume) override;
+};
+
+class NullAudio : public Audio {
+public:
+    bool open() override { return true; }
+    void close() override { }
+
+    Sound *load_sound(const char *filepath) override { return nullptr; }
+    Music *load_music(const char *filepath) override { return nullptr; }
+
+    void set_voice_count(int count) override { }
+    void play_sound(Sound *sound, int voice, float volume) override { }
+    void stop_voice(int voice) override { }
+    bool const is_voice_playing(int voice) const override { return false; }
+    void play_music(Music *music, int loops) override { }
+    void set_music_volume(float volume) override { }
+
+    bool const is_null() const override { return true; }
+};
+
+#endif // AUDIO_H
@@ -0,0 +1,109 @@
+// AudioManager.cpp
+#define LOG(argument) std::cout << argument << '\n'
+
+#include "AudioManager.hpp"
+#include "AssetLoader.hpp"
+#include <mutex>
+#include <iostream>
+
+namespace {
+    const SoundDefinition SOUND_BANK[SFX_COUNT] = {
+        // filepath     priority        interval  instances  volume
+        { "jump.wav",   PRIORITY_HIGH,  0.05f,    2,         1.0f },
+    };
+
+    const char *MUSIC_BANK[MUSIC_COUNT] = {
+        "Sergio_music.mp3",
+    };
+
+    struct Voice {
+        int             sound = -1;     // SoundId, or -1 if never used
+        SoundPriority   priority = PRIORITY_LOW;
+        Uint64          started_at = 0;
+    };
+
+    // The AssetLoader fills these in on the main thread during loading; after that
+    // they're only read
+    Sound *g_sounds[SFX_COUNT] = { nullptr };
+    Music *g_music[MUSIC_COUNT] = { nullptr };
+
+    std::mutex  g_voice_mutex;
+    Voice       g_voices[AudioManager::VOICE_COUNT];
+    Uint64      g_last_played[SFX_COUNT] = { 0 };
+    AudioStats  g_stats;
+
+    bool is_busy(int voice) {
+        return g_voices[voice].sound >= 0 and Audio::get()->is_voice_playing(voice);
+    }
+
+    // A free voice if there is one, otherwise the oldest one we're allowed to cut off
+    int find_voice(SoundPriority priority) {
+        int victim = -1;
+        for (int voice = 0; voice < AudioManager::VOICE_COUNT; voice++) {
+            if (not is_busy(voice)) return voice;
+
+            const Voice &candidate = g_voices[voice];
+            if (candidate.priority > priority) continue;
+            if (victim < 0 or candidate.priority < g_voices[victim].priority
+                or (candidate.priority == g_voices[victim].priority
+                    and candidate.started_at < g_voices[victim].started_at))
+                victim = voice;
+        }
+        return victim;
+    }
+}
+
+void AudioManager::load_bank() {
+    Audio::get()->set_voice_count(VOICE_COUNT);
+    for (int sound = 0; sound < SFX_COUNT; sound++)
+        AssetLoader::request_sound(SOUND_BANK[sound].filepath, &g_sounds[sound]);
+    for (int music = 0; music < MUSIC_COUNT; music++)
+        AssetLoader::request_music(MUSIC_BANK[music], &g_music[music]);
+}
+
+void AudioManager::play(SoundId sound) {
+    const SoundDefinition &definition = SOUND_BANK[sound];
+    Uint64 now = SDL_GetPerformanceCounter();
+
+    std::lock_guard<std::mutex> lock(g_voice_mutex);
+
+    // Rate limit first, so a sound spammed every step doesn't steal anything
+    Uint64 min_interval = (Uint64) (definition.min_interval * SDL_GetPerformanceFrequency());
+    int instances = 0;
+    for (int voice = 0; voice < VOICE_COUNT; voice++)
+        if (g_voices[voice].sound == sound and is_busy(voice)) instances++;
+    if ((g_last_played[sound] != 0 and now - g_last_played[sound] < min_interval)
+        or instances >= definition.max_instances) {
+        g_stats.dropped++;
+        return;
+    }
+
+    int voice = find_voice(definition.priority);
+    if (voice < 0) {
+        g_stats.dropped++;
+        return;
+    }
+    if (is_busy(voice)) g_stats.stolen++;
+
+    g_voices[voice] = { sound, definition.priority, now };
+    g_last_played[sound] = now;
+    g_stats.played++;
+    Audio::get()->play_sound(g_sounds[sound], voice, definition.volume);
+}
+
+void AudioManager::play_music(MusicId music, int loops) {
+    Audio::get()->play_music(g_music[music], loops);
+}
+
+void AudioManager::stop_all() {
+    std::lock_guard<std::mutex> lock(g_voice_mutex);
+    for (int voice = 0; voice < VOICE_COUNT; voice++) {
+        Audio::get()->stop_voice(voice);
+        g_voices[voice] = Voice();
+    }
+}
+
+AudioStats AudioManager::get_stats() {
+    std::lock_guard<std::mutex> lock(g_voice_mutex);
+    return g_stats;
+}
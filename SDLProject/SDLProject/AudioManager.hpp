@@ -0,0 +1,46 @@
+#ifndef AUDIOMANAGER_H
+#define AUDIOMANAGER_H
+
+#pragma once
+#include "Audio.hpp"
+
+// Everything the game can play, loaded once up front and shared by every scene
+enum SoundId        { SFX_JUMP, SFX_COUNT };
+enum MusicId        { MUSIC_BGM, MUSIC_COUNT };
+
+// When every voice is busy, a sound can only take over one of equal or lower priority
+enum SoundPriority  { PRIORITY_LOW, PRIORITY_NORMAL, PRIORITY_HIGH };
+
+struct SoundDefinition {
+    const char      *filepath;
+    SoundPriority   priority;
+    float           min_interval;   // seconds; plays closer together than this are dropped
+    int             max_instances;  // voices this sound may hold at once
+    float           volume;         // 0 to 1
+};
+
+struct AudioStats {
+    int played  = 0,
+        stolen  = 0,                // played by cutting off a lower-priority voice
+        dropped = 0;                // rate limited, or nothing to steal
+};
+
+// Sits between the game and Audio: owns the sound bank and a fixed pool of voices,
+// so a crowd of enemies all making noise can't run out of channels, drown out the
+// player, or make the loader decode something halfway through a level.
+// play() is safe to call from the simulation thread.
+class AudioManager {
+public:
+    static constexpr int VOICE_COUNT = 8;
+
+    // Queues every bank entry with the AssetLoader; call during the loading screen
+    static void load_bank();
+
+    static void play(SoundId sound);
+    static void play_music(MusicId music, int loops);
+    static void stop_all();
+
+    static AudioStats get_stats();
+};
+
+#endif // AUDIOMANAGER_H
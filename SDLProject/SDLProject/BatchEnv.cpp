@@ -0,0 +1,193 @@
+// BatchEnv.cpp
+#include "BatchEnv.hpp"
+#include "Renderer.hpp"
+#include <algorithm>
+
+BatchEnv::BatchEnv(SceneRegistry::Factory factory, int env_count, float timestep,
+                   int thread_count, int max_episode_steps) :
+m_factory(factory), m_timestep(timestep), m_max_episode_steps(max_episode_steps),
+m_envs(std::max(1, env_count)), m_observations(m_envs.size()), m_rewards(m_envs.size(), 0.0f),
+m_dones(m_envs.size(), 0) {
+    // Maps build their vertices through the renderer even when nothing will draw them
+    if (not Renderer::get()) {
+        Renderer::set(new NullRenderer());
+        m_owns_renderer = true;
+    }
+    // Thousands of copies printing every collision would be all the output there was
+    m_logged_events = Entity::s_log_events;
+    Entity::s_log_events = false;
+
+    if (thread_count <= 0) thread_count = (int) std::max(1u, std::thread::hardware_concurrency());
+    // The thread calling step() does its share too
+    for (int i = 1; i < thread_count; i++)
+        m_workers.push_back(std::thread(&BatchEnv::worker_loop, this));
+
+    run_all(&BatchEnv::build_env);
+    reset(0);
+}
+
+BatchEnv::~BatchEnv() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_work_ready.notify_all();
+    for (std::thread &worker : m_workers) worker.join();
+
+    for (Env &env : m_envs) delete env.scene;
+    Entity::s_log_events = m_logged_events;
+    if (m_owns_renderer) {
+        delete Renderer::get();
+        Renderer::set(nullptr);
+    }
+}
+
+/* ----- THREAD POOL ----- */
+
+void BatchEnv::worker_loop() {
+    int seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_work_ready.wait(lock, [this, seen] { return m_stopping or m_generation != seen; });
+            if (m_stopping) return;
+            seen = m_generation;
+        }
+        run_chunks();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_busy == 0) m_work_done.notify_one();
+        }
+    }
+}
+
+void BatchEnv::run_chunks() {
+    int count = (int) m_envs.size();
+    while (true) {
+        int first = m_next_chunk.fetch_add(CHUNK_SIZE);
+        if (first >= count) return;
+        int last = std::min(first + CHUNK_SIZE, count);
+        for (int i = first; i < last; i++) (this->*m_task)(i);
+    }
+}
+
+void BatchEnv::run_all(void (BatchEnv::*task)(int)) {
+    m_task = task;
+    m_next_chunk = 0;
+    if (m_workers.empty()) {
+        run_chunks();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_generation++;
+        m_busy = (int) m_workers.size();
+    }
+    m_work_ready.notify_all();
+    run_chunks();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_work_done.wait(lock, [this] { return m_busy == 0; });
+}
+
+/* ----- COPIES ----- */
+
+void BatchEnv::build_env(int index) {
+    Env &env = m_envs[index];
+    env.scene = m_factory();
+    env.scene->set_lives(&env.lives);
+    env.scene->build();
+    env.scene->save_state(env.start_state);
+}
+
+void BatchEnv::reset_env(int index) {
+    Env &env = m_envs[index];
+    env.scene->load_state(env.start_state);     // lives included
+    env.steps = 0;
+
+    int idle_steps = (int) (env.seed % (MAX_IDLE_START_STEPS + 1));
+    for (int i = 0; i < idle_steps; i++) simulate(env, 0);
+
+    env.enemies_left = 0;
+    for (Entity *enemy : env.scene->m_game_state.enemies)
+        if (enemy->get_active_state()) env.enemies_left++;
+}
+
+// The same as a fixed step in the game (see simulate_step in main.cpp), less the
+// spatial index, since nothing here asks it what's on screen
+void BatchEnv::simulate(Env &env, Uint8 action) {
+    StepInput input;
+    input.left  = (action & BATCH_LEFT) != 0;
+    input.right = (action & BATCH_RIGHT) != 0;
+    input.jump  = (action & BATCH_JUMP) != 0;
+
+    Entity *player = env.scene->m_game_state.player;
+    Scene::move_player(player, input);
+    env.scene->update(m_timestep);
+    if (player->get_pos().y < -10.0f) player->kill_off();
+}
+
+void BatchEnv::step_env(int index) {
+    Env &env = m_envs[index];
+    int lives_before   = env.lives,
+        enemies_before = env.enemies_left;
+
+    simulate(env, m_actions[index]);
+    env.steps++;
+
+    env.enemies_left = 0;
+    for (Entity *enemy : env.scene->m_game_state.enemies)
+        if (enemy->get_active_state()) env.enemies_left++;
+
+    m_rewards[index] = (float) (enemies_before - env.enemies_left) - (float) (lives_before - env.lives);
+    bool done = env.lives <= 0 or env.enemies_left == 0
+                or (m_max_episode_steps > 0 and env.steps >= m_max_episode_steps);
+    m_dones[index] = done ? 1 : 0;
+
+    if (done) {
+        // A new seed for each episode, from the last one
+        env.seed = env.seed * 1664525u + 1013904223u;
+        reset_env(index);
+    }
+    observe(index);
+}
+
+void BatchEnv::observe(int index) {
+    const Env &env = m_envs[index];
+    const Entity *player = env.scene->m_game_state.player;
+    BatchObservation &observation = m_observations[index];
+
+    observation.player_x     = player->get_pos().x;
+    observation.player_y     = player->get_pos().y;
+    observation.velocity_x   = player->get_vel().x;
+    observation.velocity_y   = player->get_vel().y;
+    observation.lives        = (float) env.lives;
+    observation.enemies_left = (float) env.enemies_left;
+
+    const std::vector<Entity*> &enemies = env.scene->m_game_state.enemies;
+    for (int i = 0; i < BatchObservation::MAX_ENEMIES; i++) {
+        bool present = i < (int) enemies.size() and enemies[i] != player;
+        observation.enemies[i][0] = present ? enemies[i]->get_pos().x - player->get_pos().x : 0.0f;
+        observation.enemies[i][1] = present ? enemies[i]->get_pos().y - player->get_pos().y : 0.0f;
+        observation.enemies[i][2] = present and enemies[i]->get_active_state() ? 1.0f : 0.0f;
+    }
+}
+
+/* ----- INTERFACE ----- */
+
+const BatchObservation *BatchEnv::reset(Uint32 seed) {
+    for (int i = 0; i < (int) m_envs.size(); i++) m_envs[i].seed = seed + (Uint32) i;
+    run_all(&BatchEnv::reset_env);
+    for (int i = 0; i < (int) m_envs.size(); i++) observe(i);
+    std::fill(m_rewards.begin(), m_rewards.end(), 0.0f);
+    std::fill(m_dones.begin(), m_dones.end(), 0);
+    return m_observations.data();
+}
+
+const BatchObservation *BatchEnv::step(const Uint8 *actions) {
+    m_actions = actions;
+    run_all(&BatchEnv::step_env);
+    m_actions = nullptr;
+    return m_observations.data();
+}
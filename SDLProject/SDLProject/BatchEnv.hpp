@@ -0,0 +1,116 @@
+#ifndef BATCHENV_H
+#define BATCHENV_H
+
+#pragma once
+#include <SDL.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "SceneRegistry.hpp"
+
+// One bit per control, the same as a ReplayTick's
+enum BatchAction { BATCH_LEFT = 1, BATCH_RIGHT = 2, BATCH_JUMP = 4 };
+
+// What an agent sees of one copy after a step. Enemy positions are relative to
+// the player; slots past the level's enemy count are left at zero
+struct BatchObservation {
+    static constexpr int MAX_ENEMIES = 4;
+
+    float   player_x,
+            player_y,
+            velocity_x,
+            velocity_y,
+            lives,
+            enemies_left,
+            enemies[MAX_ENEMIES][3];    // x, y, 1 if it's still up
+};
+
+// N independent copies of one level, stepped together for automated playthroughs
+// (level validation, bots) with no window, audio or main() behind them; the
+// simulation library in CMakeLists.txt is this plus what it needs. Each copy
+// is its own Scene with its own lives; the maps' tile data is only ever read, so
+// the copies share it.
+//
+// A step runs every copy once, split into chunks across a pool of threads (the
+// calling one included), and writes into buffers allocated up front, one entry per
+// copy: nothing is allocated or locked per copy per step. A copy whose episode
+// ends (out of lives, level cleared, or max_episode_steps) goes straight back to
+// the start; its done flag and reward are for the step that ended it, and its
+// observation is already the new episode's.
+//
+// The levels have no randomness of their own, so a copy's seed picks how many idle
+// steps it starts with (up to MAX_IDLE_START_STEPS), so the copies don't all
+// play out in lockstep.
+class BatchEnv {
+public:
+    static constexpr int    START_LIVES = 3,
+                            MAX_IDLE_START_STEPS = 30,
+                            DEFAULT_MAX_EPISODE_STEPS = 60 * 60;    // a minute at 60 Hz
+
+private:
+    static constexpr int CHUNK_SIZE = 64;       // copies a thread takes at a time
+
+    struct Env {
+        Scene   *scene = nullptr;
+        int     lives = START_LIVES,
+                enemies_left = 0,
+                steps = 0;
+        Uint32  seed = 0;
+        std::vector<Uint8> start_state;         // for going back to the start without a rebuild
+    };
+
+    SceneRegistry::Factory m_factory;
+    float m_timestep;
+    int m_max_episode_steps;
+
+    std::vector<Env> m_envs;                    // never resized, so scenes can point at their lives
+    std::vector<BatchObservation> m_observations;
+    std::vector<float> m_rewards;
+    std::vector<Uint8> m_dones;
+
+    /* ----- THREAD POOL ----- */
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_work_ready,
+                            m_work_done;
+    int  m_generation = 0,                      // bumped for each job
+         m_busy = 0;                            // workers still on the current one
+    bool m_stopping = false;
+    void (BatchEnv::*m_task)(int) = nullptr;    // run once per copy
+    std::atomic<int> m_next_chunk { 0 };
+    const Uint8 *m_actions = nullptr;
+
+    bool m_owns_renderer = false,
+         m_logged_events;
+
+    void worker_loop();
+    void run_chunks();
+    void run_all(void (BatchEnv::*task)(int));
+
+    void build_env(int index);
+    void reset_env(int index);
+    void step_env(int index);
+    void simulate(Env &env, Uint8 action);
+    void observe(int index);
+
+public:
+    // thread_count <= 0 uses every core
+    BatchEnv(SceneRegistry::Factory factory, int env_count, float timestep,
+             int thread_count = 0, int max_episode_steps = DEFAULT_MAX_EPISODE_STEPS);
+    ~BatchEnv();
+
+    // Every copy back to the start, copy i with seed + i
+    const BatchObservation *reset(Uint32 seed);
+    // actions: one BatchAction mask per copy
+    const BatchObservation *step(const Uint8 *actions);
+
+    int const get_env_count() const { return (int) m_envs.size(); }
+    int const get_thread_count() const { return (int) m_workers.size() + 1; }
+    const BatchObservation *get_observations() const { return m_observations.data(); }
+    const float *get_rewards() const { return m_rewards.data(); }   // enemies beaten minus lives lost
+    const Uint8 *get_dones() const { return m_dones.data(); }
+};
+
+#endif // BATCHENV_H
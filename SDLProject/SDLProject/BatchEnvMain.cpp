@@ -0,0 +1,62 @@
+// BatchEnvMain.cpp
+// The batch_env target in CMakeLists.txt: a minimal program on the simulation
+// library alone, stepping copies of level 1 with random input and reporting how
+// many steps a second that comes to.
+//
+//   --envs <n>      copies             (default 1024)
+//   --threads <n>   threads            (default every core)
+//   --steps <n>     steps of each copy (default 600)
+#define LOG(argument) std::cout << argument << '\n'
+
+#include <SDL.h>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "BatchEnv.hpp"
+#include "Level1.hpp"
+
+constexpr float FIXED_TIMESTEP = 1.0f / 60.0f;
+
+int main(int argc, char* argv[]) {
+    int env_count    = 1024,
+        thread_count = 0,
+        step_count   = 600;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--envs" and i + 1 < argc) env_count = std::max(1, atoi(argv[++i]));
+        else if (arg == "--threads" and i + 1 < argc) thread_count = atoi(argv[++i]);
+        else if (arg == "--steps" and i + 1 < argc) step_count = std::max(1, atoi(argv[++i]));
+    }
+
+    SDL_Init(0);
+    {
+        BatchEnv batch([] { return (Scene*) new Level1(); }, env_count, FIXED_TIMESTEP, thread_count);
+
+        // A fresh action for every copy every step, decided before the clock starts
+        std::vector<Uint8> actions((size_t) step_count * env_count);
+        Uint32 random = 1;
+        for (Uint8 &action : actions) {
+            random = random * 1664525u + 1013904223u;
+            action = (Uint8) ((random >> 16) % 8);
+        }
+
+        int episodes = 0;
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int step = 0; step < step_count; step++) {
+            batch.step(&actions[(size_t) step * env_count]);
+            const Uint8 *dones = batch.get_dones();
+            for (int i = 0; i < env_count; i++) episodes += dones[i];
+        }
+        double seconds = (double) (SDL_GetPerformanceCounter() - start)
+                         / (double) SDL_GetPerformanceFrequency();
+
+        LOG(env_count << " copies of level 1 on " << batch.get_thread_count() << " thread(s): "
+            << (long long) step_count * env_count << " steps in " << seconds * 1000.0 << " ms ("
+            << (long long) (step_count * (double) env_count / seconds) << " steps/s), "
+            << episodes << " episodes finished.");
+    }
+    SDL_Quit();
+    return 0;
+}
@@ -0,0 +1,407 @@
+// Benchmark.cpp
+#define LOG(argument) std::cout << argument << '\n'
+
+#include "Benchmark.hpp"
+#include "Map.hpp"
+#include "Entity.hpp"
+#include "Utility.hpp"
+#include "Renderer.hpp"
+#include "BatchEnv.hpp"
+#include "Script.hpp"
+#include "AIScheduler.hpp"
+#include "Level1.hpp"
+#include <vector>
+#include <string>
+#include <functional>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+namespace {
+    constexpr int   BENCHMARK_FORMAT_VERSION = 1;
+    constexpr int   RANDOM_QUERIES      = 1 << 20,
+                    UPDATE_TICKS        = 60,
+                    COLLISION_CALLS     = 100,
+                    TEXT_CALLS          = 10000,
+                    BUILD_COUNT         = 3;
+    constexpr float SOLID_DENSITY       = 0.3f,
+                    FIXED_TIMESTEP      = 1.0f / 60.0f;
+    const glm::vec3 GRAVITY = glm::vec3(0.0f, -6.0f, 0.0f);
+
+    struct BenchConfig {
+        int map_width       = 1024,
+            map_height      = 64,
+            entity_count    = 1000,
+            text_length     = 64,
+            batch_envs      = 1024,
+            batch_threads   = 0,
+            ai_budget       = AIScheduler::DEFAULT_BUDGET,
+            repeats         = 5;
+        std::string out_path;
+    };
+
+    struct BenchResult {
+        std::string name;
+        long long ops;
+        double best_ms,
+               median_ms;
+    };
+
+    // Anything a benchmark computes gets folded in here so it can't be optimised away
+    volatile float g_sink = 0.0f;
+
+    // Progress lines would corrupt the JSON when it goes to stdout
+    bool g_log_progress = false;
+
+    Uint32 g_random_state = 0x9E3779B9;
+
+    Uint32 next_random() {
+        // xorshift32: cheap and, more importantly, the same on every machine
+        g_random_state ^= g_random_state << 13;
+        g_random_state ^= g_random_state >> 17;
+        g_random_state ^= g_random_state << 5;
+        return g_random_state;
+    }
+
+    float random_float(float min, float max) {
+        return min + (max - min) * (float) (next_random() & 0xFFFFFF) / (float) 0xFFFFFF;
+    }
+
+    double elapsed_ms(Uint64 start) {
+        return (double) (SDL_GetPerformanceCounter() - start) * 1000.0
+               / (double) SDL_GetPerformanceFrequency();
+    }
+
+    // Runs body once to warm up, then `repeats` timed runs; body returns its op count
+    BenchResult measure(const std::string &name, int repeats, std::function<long long()> body) {
+        body();
+
+        std::vector<double> times;
+        long long ops = 0;
+        for (int i = 0; i < repeats; i++) {
+            Uint64 start = SDL_GetPerformanceCounter();
+            ops = body();
+            times.push_back(elapsed_ms(start));
+        }
+        std::sort(times.begin(), times.end());
+
+        if (g_log_progress) LOG(name << ": " << times[0] * 1.0e6 / ops << " ns/op");
+        return { name, ops, times[0], times[times.size() / 2] };
+    }
+
+    // Random tiles at SOLID_DENSITY, with a solid floor so walkers have something to stand on
+    std::vector<unsigned int> make_level_data(int width, int height, float density) {
+        std::vector<unsigned int> data(width * height, 0);
+        for (int y = 0; y < height - 1; y++)
+            for (int x = 0; x < width; x++)
+                if (random_float(0.0f, 1.0f) < density) data[y * width + x] = 1 + next_random() % 179;
+        for (int x = 0; x < width; x++) data[(height - 1) * width + x] = 122;
+        return data;
+    }
+
+    std::vector<unsigned int> make_flat_level_data(int width, int height) {
+        std::vector<unsigned int> data(width * height, 0);
+        for (int x = 0; x < width; x++) data[(height - 1) * width + x] = 122;
+        return data;
+    }
+
+    /* ----- MAP ----- */
+    void bench_map(const BenchConfig &config, std::vector<BenchResult> &results) {
+        std::vector<unsigned int> data = make_level_data(config.map_width, config.map_height,
+                                                         SOLID_DENSITY);
+        Map map(config.map_width, config.map_height, data.data(), 1, 1.0f, 20, 9);
+
+        std::vector<glm::vec3> random_positions;
+        for (int i = 0; i < RANDOM_QUERIES; i++)
+            random_positions.push_back(glm::vec3(random_float(map.get_left_bound(), map.get_right_bound()),
+                                                 random_float(map.get_bottom_bound(), map.get_top_bound()),
+                                                 0.0f));
+
+        results.push_back(measure("map_is_solid_random", config.repeats, [&] {
+            float penetration_x, penetration_y, total = 0.0f;
+            for (const glm::vec3 &position : random_positions)
+                if (map.is_solid(position, &penetration_x, &penetration_y)) total += penetration_y;
+            g_sink = g_sink + total;
+            return (long long) random_positions.size();
+        }));
+
+        results.push_back(measure("map_is_solid_sequential", config.repeats, [&] {
+            float penetration_x, penetration_y, total = 0.0f;
+            for (int y = 0; y < config.map_height; y++)
+                for (int x = 0; x < config.map_width; x++)
+                    if (map.is_solid(glm::vec3(x, -y, 0.0f), &penetration_x, &penetration_y))
+                        total += penetration_x;
+            g_sink = g_sink + total;
+            return (long long) config.map_width * config.map_height;
+        }));
+
+        // The eight points Entity::check_collision_x/y ask about, swept along a row
+        results.push_back(measure("map_is_solid_probe", config.repeats, [&] {
+            const float half = 0.5f;
+            const glm::vec3 probes[] = {
+                glm::vec3(0.0f, half, 0.0f), glm::vec3(-half, half, 0.0f), glm::vec3(half, half, 0.0f),
+                glm::vec3(0.0f, -half, 0.0f), glm::vec3(-half, -half, 0.0f), glm::vec3(half, -half, 0.0f),
+                glm::vec3(-half, 0.0f, 0.0f), glm::vec3(half, 0.0f, 0.0f)
+            };
+            float penetration_x, penetration_y, total = 0.0f;
+            long long ops = 0;
+            for (int row = 0; row < config.map_height; row++) {
+                for (float x = 0.0f; x < config.map_width - 1; x += 0.1f) {
+                    glm::vec3 centre = glm::vec3(x, -row, 0.0f);
+                    for (const glm::vec3 &probe : probes) {
+                        if (map.is_solid(centre + probe, &penetration_x, &penetration_y))
+                            total += penetration_x;
+                        ops++;
+                    }
+                }
+            }
+            g_sink = g_sink + total;
+            return ops;
+        }));
+
+        // A much bigger grid than the one above, to see how build scales
+        int build_width = config.map_width * 4,
+            build_height = config.map_height * 4;
+        std::vector<unsigned int> build_data = make_level_data(build_width, build_height, SOLID_DENSITY);
+        results.push_back(measure("map_build", config.repeats, [&] {
+            for (int i = 0; i < BUILD_COUNT; i++) {
+                Map built(build_width, build_height, build_data.data(), 1, 1.0f, 20, 9);
+                g_sink = g_sink + (float) built.get_vertices().size();
+            }
+            return (long long) BUILD_COUNT * build_width * build_height;
+        }));
+    }
+
+    /* ----- ENTITY ----- */
+    void bench_entities(const BenchConfig &config, std::vector<BenchResult> &results) {
+        std::vector<unsigned int> data = make_flat_level_data(config.map_width, config.map_height);
+        Map map(config.map_width, config.map_height, data.data(), 1, 1.0f, 20, 9);
+
+        std::vector<int> walk_animation = { 21, 22 };
+        Entity player(1, 4.0f, GRAVITY, 4.0f, walk_animation, 0.5f, PLAYER);
+        player.set_pos(glm::vec3(1.0f, -(config.map_height - 2), 0.0f));
+
+        std::vector<Entity*> walkers;
+        for (int i = 0; i < config.entity_count; i++) {
+            Entity *walker = new Entity(1, 1.0f, GRAVITY, 3.0f, walk_animation, 0.75f,
+                                        ENEMY, WALKER, IDLE);
+            walker->set_pos(glm::vec3(1 + i % (config.map_width - 2), -(config.map_height - 2), 0.0f));
+            walkers.push_back(walker);
+        }
+
+        results.push_back(measure("entity_update_walkers", config.repeats, [&] {
+            for (int tick = 0; tick < UPDATE_TICKS; tick++)
+                for (Entity *walker : walkers)
+                    walker->update(&map, FIXED_TIMESTEP, &player);
+            g_sink = g_sink + walkers[0]->get_pos().x;
+            return (long long) UPDATE_TICKS * walkers.size();
+        }));
+
+        // Objects well out of reach, so this measures the scan rather than the kill-offs
+        std::vector<Entity*> objects;
+        for (int i = 0; i < config.entity_count; i++) {
+            Entity *object = new Entity(1, 1.0f, GRAVITY, 3.0f, walk_animation, 0.75f,
+                                        ENEMY, WALKER, IDLE);
+            object->set_pos(glm::vec3((float) i, 100.0f, 0.0f));
+            objects.push_back(object);
+        }
+
+        results.push_back(measure("entity_check_collision_x", config.repeats, [&] {
+            for (int i = 0; i < COLLISION_CALLS; i++)
+                player.check_collision_x(objects, (int) objects.size());
+            g_sink = g_sink + player.get_pos().x;
+            return (long long) COLLISION_CALLS * objects.size();
+        }));
+
+        results.push_back(measure("entity_check_collision_y", config.repeats, [&] {
+            for (int i = 0; i < COLLISION_CALLS; i++)
+                player.check_collision_y(objects, (int) objects.size());
+            g_sink = g_sink + player.get_pos().y;
+            return (long long) COLLISION_CALLS * objects.size();
+        }));
+
+        for (Entity *walker : walkers) delete walker;
+        for (Entity *object : objects) delete object;
+    }
+
+    /* ----- AI ----- */
+    // Just the decisions, for entity_count guards spread along a level with the
+    // player in the middle: all of them every step, then through an AIScheduler
+    void bench_ai(const BenchConfig &config, std::vector<BenchResult> &results) {
+        std::vector<int> walk_animation = { 21, 22 };
+        Entity player(1, 4.0f, GRAVITY, 4.0f, walk_animation, 0.5f, PLAYER);
+        player.set_pos(glm::vec3(config.map_width / 2.0f, -(config.map_height - 2), 0.0f));
+
+        std::vector<Entity*> guards;
+        for (int i = 0; i < config.entity_count; i++) {
+            Entity *guard = new Entity(1, 1.0f, GRAVITY, 3.0f, walk_animation, 0.75f,
+                                       ENEMY, GUARD, IDLE);
+            guard->set_pos(glm::vec3(1 + i % (config.map_width - 2), -(config.map_height - 2), 0.0f));
+            guards.push_back(guard);
+        }
+
+        results.push_back(measure("ai_decide_every_step", config.repeats, [&] {
+            float total = 0.0f;
+            for (int tick = 0; tick < UPDATE_TICKS; tick++)
+                for (Entity *guard : guards) total += guard->ai_decide(&player);
+            g_sink = g_sink + total;
+            return (long long) UPDATE_TICKS * guards.size();
+        }));
+
+        AIScheduler scheduler;
+        scheduler.set_budget(config.ai_budget);
+        results.push_back(measure("ai_scheduled", config.repeats, [&] {
+            for (int tick = 0; tick < UPDATE_TICKS; tick++) scheduler.schedule(guards, &player);
+            g_sink = g_sink + (float) guards[0]->get_ai_wait();
+            return (long long) UPDATE_TICKS * guards.size();
+        }));
+
+        for (Entity *guard : guards) delete guard;
+    }
+
+    /* ----- SCRIPTS ----- */
+    Script patrol(ScriptScheduler &scripts, Entity *walker) {
+        while (true) {
+            if (walker->get_facing_right()) walker->move_right();
+            else walker->move_left();
+            co_await scripts.until(walker, EVENT_WALL | EVENT_LEDGE);
+            walker->set_mov(glm::vec3(0.0f));
+            co_await scripts.wait(0.5f);
+            if (walker->get_facing_right()) walker->move_left();
+            else walker->move_right();
+        }
+    }
+
+    // The same walkers as entity_update_walkers, but turning round (and pausing)
+    // from a script instead of the polled AI
+    void bench_scripts(const BenchConfig &config, std::vector<BenchResult> &results) {
+        std::vector<unsigned int> data = make_flat_level_data(config.map_width, config.map_height);
+        Map map(config.map_width, config.map_height, data.data(), 1, 1.0f, 20, 9);
+
+        std::vector<int> walk_animation = { 21, 22 };
+        Entity player(1, 4.0f, GRAVITY, 4.0f, walk_animation, 0.5f, PLAYER);
+        player.set_pos(glm::vec3(1.0f, -(config.map_height - 2), 0.0f));
+
+        ScriptScheduler scripts;
+        std::vector<Entity*> walkers;
+        for (int i = 0; i < config.entity_count; i++) {
+            Entity *walker = new Entity(1, 1.0f, GRAVITY, 3.0f, walk_animation, 0.75f,
+                                        ENEMY, SCRIPTED, IDLE);
+            walker->set_pos(glm::vec3(1 + i % (config.map_width - 2), -(config.map_height - 2), 0.0f));
+            walkers.push_back(walker);
+            scripts.spawn([&scripts, walker] { return patrol(scripts, walker); });
+        }
+
+        results.push_back(measure("script_update_walkers", config.repeats, [&] {
+            for (int tick = 0; tick < UPDATE_TICKS; tick++) {
+                for (Entity *walker : walkers)
+                    walker->update(&map, FIXED_TIMESTEP, &player);
+                scripts.tick(FIXED_TIMESTEP);
+            }
+            g_sink = g_sink + walkers[0]->get_pos().x;
+            return (long long) UPDATE_TICKS * walkers.size();
+        }));
+
+        scripts.clear();
+        for (Entity *walker : walkers) delete walker;
+    }
+
+    /* ----- TEXT ----- */
+    void bench_text(const BenchConfig &config, std::vector<BenchResult> &results) {
+        std::string text;
+        for (int i = 0; i < config.text_length; i++) text += (char) ('A' + i % 26);
+
+        // With the NullRenderer active this is only the CPU-side mesh generation,
+        // plus queueing it and batching it up for the backend
+        results.push_back(measure("utility_draw_text", config.repeats, [&] {
+            for (int i = 0; i < TEXT_CALLS; i++) {
+                Utility::draw_text(nullptr, 1, text, 0.3f, 0.03f, glm::vec3(0.0f));
+                Renderer::get()->flush();
+            }
+            return (long long) TEXT_CALLS;
+        }));
+    }
+
+    /* ----- BATCH ----- */
+    void bench_batch(const BenchConfig &config, std::vector<BenchResult> &results) {
+        BatchEnv batch([] { return (Scene*) new Level1(); }, config.batch_envs, FIXED_TIMESTEP,
+                       config.batch_threads);
+
+        // A fresh action for every copy every step, like a policy would give
+        std::vector<Uint8> actions(UPDATE_TICKS * config.batch_envs);
+        for (Uint8 &action : actions) action = (Uint8) (next_random() % 8);
+
+        results.push_back(measure("batch_env_step", config.repeats, [&] {
+            for (int tick = 0; tick < UPDATE_TICKS; tick++)
+                batch.step(&actions[tick * config.batch_envs]);
+            g_sink = g_sink + batch.get_observations()[0].player_x;
+            return (long long) UPDATE_TICKS * config.batch_envs;
+        }));
+    }
+
+    std::string to_json(const BenchConfig &config, const std::vector<BenchResult> &results) {
+        std::ostringstream json;
+        json << "{\n"
+             << "  \"format_version\": " << BENCHMARK_FORMAT_VERSION << ",\n"
+             << "  \"compiler\": \"" << __VERSION__ << "\",\n"
+             << "  \"config\": { \"map_width\": " << config.map_width
+             << ", \"map_height\": " << config.map_height
+             << ", \"entity_count\": " << config.entity_count
+             << ", \"text_length\": " << config.text_length
+             << ", \"batch_envs\": " << config.batch_envs
+             << ", \"batch_threads\": " << config.batch_threads
+             << ", \"ai_budget\": " << config.ai_budget
+             << ", \"repeats\": " << config.repeats << " },\n"
+             << "  \"results\": [\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            const BenchResult &result = results[i];
+            json << "    { \"name\": \"" << result.name << "\""
+                 << ", \"ops\": " << result.ops
+                 << ", \"best_ms\": " << result.best_ms
+                 << ", \"median_ms\": " << result.median_ms
+                 << ", \"ns_per_op\": " << result.best_ms * 1.0e6 / result.ops
+                 << ", \"ops_per_sec\": " << (long long) (result.ops / (result.best_ms / 1000.0))
+                 << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        json << "  ]\n}\n";
+        return json.str();
+    }
+}
+
+int Benchmark::run(int argc, char* argv[]) {
+    BenchConfig config;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--bench-map" and i + 2 < argc) {
+            config.map_width  = std::max(4, atoi(argv[++i]));
+            config.map_height = std::max(4, atoi(argv[++i]));
+        }
+        else if (arg == "--bench-entities" and i + 1 < argc) config.entity_count = std::max(1, atoi(argv[++i]));
+        else if (arg == "--bench-text" and i + 1 < argc)     config.text_length  = std::max(1, atoi(argv[++i]));
+        else if (arg == "--bench-batch" and i + 1 < argc)    config.batch_envs   = std::max(1, atoi(argv[++i]));
+        else if (arg == "--bench-threads" and i + 1 < argc)  config.batch_threads = atoi(argv[++i]);
+        else if (arg == "--bench-ai-budget" and i + 1 < argc) config.ai_budget   = std::max(1, atoi(argv[++i]));
+        else if (arg == "--bench-repeats" and i + 1 < argc)  config.repeats      = std::max(1, atoi(argv[++i]));
+        else if (arg == "--bench-out" and i + 1 < argc)      config.out_path     = argv[++i];
+    }
+
+    g_log_progress = not config.out_path.empty();
+
+    std::vector<BenchResult> results;
+    bench_map(config, results);
+    bench_entities(config, results);
+    bench_ai(config, results);
+    bench_scripts(config, results);
+    bench_text(config, results);
+    bench_batch(config, results);
+
+    std::string json = to_json(config, results);
+    if (config.out_path.empty()) std::cout << json;
+    else {
+        std::ofstream out(config.out_path);
+        out << json;
+        LOG("Wrote " << config.out_path);
+    }
+    return 0;
+}
@@ -0,0 +1,23 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#pragma once
+
+// Microbenchmarks for the Map and Entity hot paths on synthetic data, built as the
+// bench target in CMakeLists.txt. Needs no window: everything draws through the
+// NullRenderer.
+//
+//   --bench-map <width> <height>   synthetic map size           (default 1024 64)
+//   --bench-entities <n>           walkers / collision objects  (default 1000)
+//   --bench-text <n>               characters per draw_text     (default 64)
+//   --bench-batch <n>              BatchEnv copies of level 1   (default 1024)
+//   --bench-threads <n>            BatchEnv threads             (default every core)
+//   --bench-ai-budget <n>          AIScheduler decisions a step (default 32)
+//   --bench-repeats <n>            timed runs per benchmark     (default 5)
+//   --bench-out <path>             write the JSON here instead of stdout
+class Benchmark {
+public:
+    static int run(int argc, char* argv[]);
+};
+
+#endif // BENCHMARK_H
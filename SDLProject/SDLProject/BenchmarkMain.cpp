@@ -0,0 +1,15 @@
+// BenchmarkMain.cpp
+// Entry point for the bench target in CMakeLists.txt; see Benchmark.hpp for the flags
+#include <SDL.h>
+#include "Benchmark.hpp"
+#include "Renderer.hpp"
+
+int main(int argc, char* argv[]) {
+    SDL_Init(0);
+    // Maps and text still build their vertices through a renderer
+    Renderer::set(new NullRenderer());
+    int status = Benchmark::run(argc, argv);
+    delete Renderer::get();
+    SDL_Quit();
+    return status;
+}
@@ -0,0 +1,38 @@
+// BitStream.cpp
+#include "BitStream.hpp"
+#include <cstring>
+
+BitWriter::BitWriter(Uint8 *buffer, int capacity_bytes) :
+m_buffer(buffer), m_capacity_bits(capacity_bytes * 8) {
+    memset(m_buffer, 0, capacity_bytes);
+}
+
+void BitWriter::write(Uint32 value, int bits) {
+    if (m_overflow or m_position + bits > m_capacity_bits) {
+        m_overflow = true;
+        return;
+    }
+    // A bit at a time is plenty for packets of a few hundred bytes
+    for (int i = 0; i < bits; i++, m_position++)
+        if (value & (1u << i)) m_buffer[m_position / 8] |= (Uint8) (1 << (m_position % 8));
+}
+
+BitReader::BitReader(const Uint8 *buffer, int length_bytes) :
+m_buffer(buffer), m_length_bits(length_bytes * 8) { }
+
+Uint32 BitReader::read(int bits) {
+    if (m_overflow or m_position + bits > m_length_bits) {
+        m_overflow = true;
+        return 0;
+    }
+    Uint32 value = 0;
+    for (int i = 0; i < bits; i++, m_position++)
+        if (m_buffer[m_position / 8] & (1 << (m_position % 8))) value |= 1u << i;
+    return value;
+}
+
+Sint32 BitReader::read_signed(int bits) {
+    Uint32 value = read(bits);
+    if (bits < 32 and (value & (1u << (bits - 1)))) value |= ~0u << bits;
+    return (Sint32) value;
+}
@@ -0,0 +1,50 @@
+#ifndef BITSTREAM_H
+#define BITSTREAM_H
+
+#pragma once
+#include <SDL.h>
+
+// Packs values into a byte buffer at bit granularity, lowest bit first, so a
+// field only costs the bits it needs. Writing past the end of the buffer (or
+// reading past the end of the data) sets the overflow flag instead of touching
+// memory; check it once at the end rather than after every call.
+class BitWriter {
+private:
+    Uint8 *m_buffer;
+    int m_capacity_bits,
+        m_position = 0;
+    bool m_overflow = false;
+
+public:
+    BitWriter(Uint8 *buffer, int capacity_bytes);
+
+    // bits can be 1-32; only the low bits of value are kept
+    void write(Uint32 value, int bits);
+    void write_bool(bool value) { write(value ? 1 : 0, 1); }
+    // Two's complement, masked to bits
+    void write_signed(Sint32 value, int bits) { write((Uint32) value, bits); }
+
+    int const get_bytes() const { return (m_position + 7) / 8; }
+    int const get_bits() const { return m_position; }
+    bool const has_overflowed() const { return m_overflow; }
+};
+
+class BitReader {
+private:
+    const Uint8 *m_buffer;
+    int m_length_bits,
+        m_position = 0;
+    bool m_overflow = false;
+
+public:
+    BitReader(const Uint8 *buffer, int length_bytes);
+
+    Uint32 read(int bits);
+    bool read_bool() { return read(1) != 0; }
+    // Sign-extends what write_signed wrote
+    Sint32 read_signed(int bits);
+
+    bool const has_overflowed() const { return m_overflow; }
+};
+
+#endif // BITSTREAM_H
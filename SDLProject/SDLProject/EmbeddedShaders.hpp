@@ -0,0 +1,59 @@
+// Generated by embed_shaders.sh from shaders/*.glsl -- edit those, not this
+#ifndef EMBEDDEDSHADERS_H
+#define EMBEDDEDSHADERS_H
+
+#pragma once
+
+namespace EmbeddedShaders {
+    constexpr const char FRAGMENT[] = R"glsl(
+uniform vec4 color;
+
+void main() {
+    gl_FragColor = color;
+}
+)glsl";
+
+    constexpr const char FRAGMENT_TEXTURED[] = R"glsl(
+
+uniform sampler2D diffuse;
+varying vec2 texCoordVar;
+
+void main() {
+    gl_FragColor = texture2D(diffuse, texCoordVar);
+}
+)glsl";
+
+    constexpr const char VERTEX[] = R"glsl(
+attribute vec4 position;
+
+uniform mat4 modelMatrix;
+uniform mat4 viewMatrix;
+uniform mat4 projectionMatrix;
+
+void main()
+{
+	vec4 p = viewMatrix * modelMatrix  * position;
+	gl_Position = projectionMatrix * p;
+}
+)glsl";
+
+    constexpr const char VERTEX_TEXTURED[] = R"glsl(
+attribute vec4 position;
+attribute vec2 texCoord;
+
+uniform mat4 modelMatrix;
+uniform mat4 viewMatrix;
+uniform mat4 projectionMatrix;
+
+varying vec2 texCoordVar;
+
+void main()
+{
+	vec4 p = viewMatrix * modelMatrix  * position;
+    texCoordVar = texCoord;
+	gl_Position = projectionMatrix * p;
+})glsl";
+
+}
+
+#endif // EMBEDDEDSHADERS_H
@@ -24,12 +24,16 @@
 #include <vector>
 
 #include "Entity.hpp"
+#include "Renderer.hpp"
+#include "Profiler.hpp"
 
 using namespace glm;
 
+bool Entity::s_log_events = true;
+
 // Default constructor
 Entity::Entity() :
-m_position(0.0f), m_movement(0.0f),  m_velocity(0.0f), m_acceleration(0.0f),
+m_movement(0.0f), m_position(0.0f), m_previous_position(0.0f),  m_velocity(0.0f), m_acceleration(0.0f),
 m_scale(1.0f, 1.0f, 0.0f), m_model_matrix(1.0f), m_speed(0.0f), m_animation_cols(0),
 m_animation_rows(0), m_animation_time(0.0f), m_texture_id(0), m_size(0.0f),
 m_animation_indices(nullptr) { }
@@ -37,7 +41,7 @@ m_animation_indices(nullptr) { }
 Entity::Entity(GLuint tex_id, float speed, vec3 accel, float jump_pow,
                float anim_time, int anim_index, int anim_cols, int anim_rows,
                float size, EntityType type) :
-m_position(0.0f), m_movement(0.0f), m_model_matrix(1.0f), m_velocity(0.0f),
+m_movement(0.0f), m_position(0.0f), m_previous_position(0.0f), m_model_matrix(1.0f), m_velocity(0.0f),
 m_texture_id(tex_id), m_speed(speed), m_acceleration(accel), m_jumping_power(jump_pow),
 m_animation_time(anim_time), m_animation_index(anim_index), m_animation_cols(anim_cols),
 m_animation_rows(anim_rows), m_size(size), m_entity_type(type) {
@@ -47,7 +51,7 @@ m_animation_rows(anim_rows), m_size(size), m_entity_type(type) {
 // Simpler constructor for partial initializaiton
 Entity::Entity(GLuint tex_id, float speed, vec3 accel, float jump_pow,
                std::vector<int>& walk_anim, float size, EntityType type) :
-m_position(0.0f), m_movement(0.0f), m_scale(1.0f, 1.0f, 0.0f), m_model_matrix(1.0f),
+m_movement(0.0f), m_position(0.0f), m_previous_position(0.0f), m_scale(1.0f, 1.0f, 0.0f), m_model_matrix(1.0f),
 m_velocity(0.0f), m_texture_id(tex_id), m_speed(speed), m_jumping_power(jump_pow),
 m_walk_animation(walk_anim), m_acceleration(accel), m_size(size), m_entity_type(type) {
     init_anim();
@@ -60,7 +64,7 @@ m_walk_animation(walk_anim), m_acceleration(accel), m_size(size), m_entity_type(
 Entity::Entity(GLuint tex_id, float speed, vec3 accel, float jump_pow,
                std::vector<int>& walk_anim, float size, EntityType entity_type,
                AIType ai_type, AIState ai_state) :
-m_position(0.0f), m_movement(0.0f), m_scale(1.0f, 1.0f, 0.0f), m_model_matrix(1.0f),
+m_movement(0.0f), m_position(0.0f), m_previous_position(0.0f), m_scale(1.0f, 1.0f, 0.0f), m_model_matrix(1.0f),
 m_velocity(0.0f), m_texture_id(tex_id), m_speed(speed), m_jumping_power(jump_pow),
 m_walk_animation(walk_anim), m_acceleration(accel), m_size(size), m_entity_type(entity_type),
 m_ai_type(ai_type), m_ai_state(ai_state) {
@@ -74,9 +78,12 @@ m_ai_type(ai_type), m_ai_state(ai_state) {
 Entity::~Entity() { }
 // might split into ai update and player update
 void Entity::update(Map* map, float delta_time, Entity* player,
-                    std::vector<Entity*> objects, int object_count) {
+                    const std::vector<Entity*> &objects, int object_count) {
     
     if (not m_is_active) return;
+    PROFILE_SCOPE("Entity::update");
+    
+    m_previous_position = m_position;
     
     m_collided_top = false;
     m_collided_bottom = false;
@@ -137,20 +144,60 @@ void Entity::update(Map* map, float delta_time, Entity* player,
         m_velocity.y += m_jumping_power;
     }
     
-    m_model_matrix = mat4(1.0f);
-    m_model_matrix = translate(m_model_matrix, m_position);
-    if (m_is_facing_right)
-        m_model_matrix = scale(m_model_matrix, vec3(-1 * m_scale.x, m_scale.y, m_scale.z));
-    else m_model_matrix = scale(m_model_matrix, m_scale);
+    m_model_matrix = get_model_matrix(1.0f);
 }
 
-void Entity::render(ShaderProgram* program) {
-    program->SetModelMatrix(m_model_matrix);
-    
+mat4 const SpriteSnapshot::get_model_matrix(float alpha) const {
+    mat4 model_matrix = mat4(1.0f);
+    model_matrix = translate(model_matrix, get_interpolated_pos(alpha));
+    if (is_facing_right)
+        model_matrix = scale(model_matrix, vec3(-1 * scale_factor.x, scale_factor.y, scale_factor.z));
+    else model_matrix = scale(model_matrix, scale_factor);
+    return model_matrix;
+}
+
+Bounds const SpriteSnapshot::get_bounds(float alpha) const {
+    vec3 position = get_interpolated_pos(alpha);
+    float half_width  = fabs(scale_factor.x) / 2.0f,
+          half_height = fabs(scale_factor.y) / 2.0f;
+    return { position.x - half_width, position.x + half_width,
+             position.y - half_height, position.y + half_height };
+}
+
+SpriteSnapshot const Entity::get_snapshot() const {
+    SpriteSnapshot snapshot;
+    snapshot.texture_id         = m_texture_id;
+    snapshot.sprite_index       = m_animation_indices != nullptr ? m_animation_indices[0][m_animation_index] : -1;
+    snapshot.animation_cols     = m_animation_cols;
+    snapshot.animation_rows     = m_animation_rows;
+    snapshot.previous_position  = m_previous_position;
+    snapshot.current_position   = m_position;
+    snapshot.scale_factor       = m_scale;
+    snapshot.is_facing_right    = m_is_facing_right;
+    return snapshot;
+}
+
+mat4 const Entity::get_model_matrix(float alpha) const {
+    return get_snapshot().get_model_matrix(alpha);
+}
+
+Bounds const Entity::get_bounds(float alpha) const {
+    return get_snapshot().get_bounds(alpha);
+}
+
+void Entity::render(ShaderProgram* program, float alpha) {
     if (not m_is_active) return;
+    render_snapshot(program, get_snapshot(), alpha);
+}
+
+void Entity::render_snapshot(ShaderProgram *program, const SpriteSnapshot &snapshot, float alpha) {
+    if (not Renderer::get()->is_visible(snapshot.get_bounds(alpha))) return;
+    
+    mat4 model_matrix = snapshot.get_model_matrix(alpha);
     
-    if (m_animation_indices != nullptr) {
-        draw_sprite_from_texture_atlas(program, m_animation_indices[0][m_animation_index]);
+    if (snapshot.sprite_index >= 0) {
+        draw_sprite(program, snapshot.texture_id, snapshot.animation_cols, snapshot.animation_rows,
+                    snapshot.sprite_index, model_matrix);
         return;
     }
     
@@ -163,28 +210,22 @@ void Entity::render(ShaderProgram* program) {
         -0.5,  0.5
     };
     
+    TextureRegion region = Renderer::get()->get_region(snapshot.texture_id);
+    float u_left   = region.map_u(0.0f),
+          u_right  = region.map_u(1.0f),
+          v_top    = region.map_v(0.0f),
+          v_bottom = region.map_v(1.0f);
+    
     float texCoords[] = {
-        0.0f, 1.0f,
-        1.0f, 1.0f,
-        1.0f, 0.0f,
-        0.0f, 1.0f,
-        1.0f, 0.0f,
-        0.0f, 0.0f
+        u_left, v_bottom,
+        u_right, v_bottom,
+        u_right, v_top,
+        u_left, v_bottom,
+        u_right, v_top,
+        u_left, v_top
     };
         
-    glBindTexture(GL_TEXTURE_2D, m_texture_id);
-        
-        glVertexAttribPointer(program->positionAttribute, 2, GL_FLOAT, false, 0, vertices);
-        glEnableVertexAttribArray(program->positionAttribute);
-            
-        glVertexAttribPointer(program->texCoordAttribute, 2, GL_FLOAT, false, 0, texCoords);
-        glEnableVertexAttribArray(program->texCoordAttribute);
-            
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-            
-        glDisableVertexAttribArray(program->positionAttribute);
-        glDisableVertexAttribArray(program->texCoordAttribute);
-    
+    Renderer::get()->draw_triangles(program, snapshot.texture_id, model_matrix, vertices, texCoords, 6);
 }
 
 bool const Entity::check_collision(Entity *other) const {
@@ -195,7 +236,7 @@ bool const Entity::check_collision(Entity *other) const {
     return x_dist < 0.0f and y_dist < 0.0f;
 }
 
-void Entity::check_collision_y(std::vector<Entity*> objects, int object_count) {
+void Entity::check_collision_y(const std::vector<Entity*> &objects, int object_count) {
     for (int i = 0; i < object_count; i++) {
         Entity *object = objects[i];
         
@@ -218,12 +259,12 @@ void Entity::check_collision_y(std::vector<Entity*> objects, int object_count) {
     }
 }
 
-void Entity::check_collision_x(std::vector<Entity*> objects, int object_count) {
+void Entity::check_collision_x(const std::vector<Entity*> &objects, int object_count) {
     for (int i = 0; i < object_count; i++) {
         Entity *object = objects[i];
         
         if (check_collision(object)) {
-            LOG("collision in the x");
+            if (s_log_events) LOG("collision in the x");
             float x_dist = fabs(m_position.x - object->m_position.x);
             float x_overlap = fabs(x_dist - (m_size / 2.0f) - (object->m_size / 2.0f));
             if (m_velocity.x > 0) {
@@ -246,6 +287,8 @@ void Entity::check_collision_x(std::vector<Entity*> objects, int object_count) {
 }
 
 void Entity::check_collision_y(Map *map) {
+    PROFILE_SCOPE("Entity::check_collision_y(map)");
+    
     // Probes for tiles above
     vec3 top = vec3(m_position.x, m_position.y + (m_size / 2), m_position.z);
     vec3 top_left = vec3(m_position.x - (m_size / 2), m_position.y + (m_size / 2), m_position.z);
@@ -297,6 +340,8 @@ void Entity::check_collision_y(Map *map) {
 }
 
 void Entity::check_collision_x(Map *map) {
+    PROFILE_SCOPE("Entity::check_collision_x(map)");
+    
     // Probes for tiles; the x-checking is much simpler
     vec3 left   = vec3(m_position.x - (m_size / 2), m_position.y, m_position.z);
     vec3 right  = vec3(m_position.x + (m_size / 2), m_position.y, m_position.z);
@@ -345,23 +390,36 @@ void Entity::check_platform_x(Map *map, float delta_x) {
     }
 }
 
-void Entity::draw_sprite_from_texture_atlas(ShaderProgram *program, int index) const {
+void Entity::draw_sprite_from_texture_atlas(ShaderProgram *program, int index,
+                                            const mat4 &model_matrix) const {
+    draw_sprite(program, m_texture_id, m_animation_cols, m_animation_rows, index, model_matrix);
+}
+
+void Entity::draw_sprite(ShaderProgram *program, GLuint texture_id, int animation_cols,
+                         int animation_rows, int index, const mat4 &model_matrix) {
     // Step 1: Calculate the UV location of the indexed frame
-    float u_coord = (float) (index % m_animation_cols) / (float) m_animation_cols;
-    float v_coord = (float) (index / m_animation_cols) / (float) m_animation_rows;
+    float u_coord = (float) (index % animation_cols) / (float) animation_cols;
+    float v_coord = (float) (index / animation_cols) / (float) animation_rows;
 
     // Step 2: Calculate its UV size
-    float width = 1.0f / (float) m_animation_cols;
-    float height = 1.0f / (float) m_animation_rows;
-
-    // Step 3: Just as we have done before, match the texture coordinates to the vertices
+    float width = 1.0f / (float) animation_cols;
+    float height = 1.0f / (float) animation_rows;
+
+    // Step 3: Just as we have done before, match the texture coordinates to the vertices,
+    //         moved into wherever the sheet sits in the atlas
+    TextureRegion region = Renderer::get()->get_region(texture_id);
+    float u_left   = region.map_u(u_coord),
+          u_right  = region.map_u(u_coord + width),
+          v_top    = region.map_v(v_coord),
+          v_bottom = region.map_v(v_coord + height);
+    
     float tex_coords[] = {
-        u_coord, v_coord + height,
-        u_coord + width, v_coord + height,
-        u_coord + width, v_coord,
-        u_coord, v_coord + height,
-        u_coord + width, v_coord,
-        u_coord, v_coord
+        u_left, v_bottom,
+        u_right, v_bottom,
+        u_right, v_top,
+        u_left, v_bottom,
+        u_right, v_top,
+        u_left, v_top
     };
 
     float vertices[] = {
@@ -374,26 +432,11 @@ void Entity::draw_sprite_from_texture_atlas(ShaderProgram *program, int index) c
     };
 
     // Step 4: And render
-    if (m_texture_id == 0) {
+    if (texture_id == 0) {
         LOG("ERROR: Invalid texture ID!");
         return;
     }
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_texture_id);
-    
-
-    glVertexAttribPointer(program->positionAttribute, 2,
-                          GL_FLOAT, false, 0, vertices);
-    glEnableVertexAttribArray(program->positionAttribute);
-
-    glVertexAttribPointer(program->texCoordAttribute, 2, GL_FLOAT, false, 0,
-                          tex_coords);
-    glEnableVertexAttribArray(program->texCoordAttribute);
-    
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    
-    glDisableVertexAttribArray(program->positionAttribute);
-    glDisableVertexAttribArray(program->texCoordAttribute);
+    Renderer::get()->draw_triangles(program, texture_id, model_matrix, vertices, tex_coords, 6);
 }
 // specifc to tilemap
 void Entity::init_anim() {
@@ -406,16 +449,26 @@ void Entity::init_anim() {
 }
 
 void Entity::ai_activate(Entity *player) {
+    ai_steer();
+    if (not m_ai_clock) ai_decide(player);
+}
+
+void Entity::ai_steer() {
     switch (m_ai_type) {
         case WALKER:
             ai_walk();
             break;
-        case GUARD: ai_guard(player); break;
         case JUMPER: ai_jump(); break;
         default: break;
     }
 }
 
+float Entity::ai_decide(Entity *player) {
+    float player_distance = distance(m_position, player->get_pos());
+    if (m_ai_type == GUARD) ai_guard(player, player_distance);
+    return player_distance;
+}
+
 void Entity::ai_walk() {
     float mov = 0.0f;
     if (m_collided_bottom) {
@@ -429,10 +482,10 @@ void Entity::ai_jump() {
     jump();
 }
 
-void Entity::ai_guard(Entity *player) {
+void Entity::ai_guard(Entity *player, float player_distance) {
     switch (m_ai_state) {
         case IDLE:
-            if (distance(m_position, player->get_pos()) < 3.0f)
+            if (player_distance < 3.0f)
                 m_ai_state = WALKING;
             break;
         case WALKING:
@@ -450,19 +503,66 @@ void Entity::kill_off() {
     m_is_active = false;
 
     m_position = vec3(0.0f, -10.0f, 0.0f);
+    m_previous_position = m_position;
 
     m_velocity = vec3(0.0f, 0.0f, 0.0f);
 
     m_model_matrix = mat4(1.0f);
 
-    LOG("Enemy has been killed off.");
+    if (s_log_events) LOG("Enemy has been killed off.");
 }
 
 void Entity::reset(Map *map, vec3 pos) {
     activate();
     m_is_facing_right = true;
     m_position = pos;
+    m_previous_position = pos;
     m_movement = vec3(0.0f);
     update(map);
 }
 
+EntityState const Entity::save_state() const {
+    EntityState state;
+    state.position          = m_position;
+    state.previous_position = m_previous_position;
+    state.velocity          = m_velocity;
+    state.movement          = m_movement;
+    state.animation_time    = m_animation_time;
+    state.ai_wait           = get_ai_wait();
+    state.ai_state          = (Uint8) m_ai_state;
+    state.animation_index   = (Uint8) m_animation_index;
+    state.flags = (m_is_active       ? STATE_ACTIVE          : 0)
+                | (m_is_jumping      ? STATE_JUMPING         : 0)
+                | (m_is_facing_right ? STATE_FACING_RIGHT    : 0)
+                | (m_collided_top    ? STATE_COLLIDED_TOP    : 0)
+                | (m_collided_bottom ? STATE_COLLIDED_BOTTOM : 0)
+                | (m_collided_right  ? STATE_COLLIDED_RIGHT  : 0)
+                | (m_collided_left   ? STATE_COLLIDED_LEFT   : 0)
+                | (m_gap_bottom_left  ? STATE_GAP_BOTTOM_LEFT  : 0)
+                | (m_gap_bottom_right ? STATE_GAP_BOTTOM_RIGHT : 0);
+    return state;
+}
+
+void Entity::load_state(const EntityState &state) {
+    m_position          = state.position;
+    m_previous_position = state.previous_position;
+    m_velocity          = state.velocity;
+    m_movement          = state.movement;
+    m_animation_time    = state.animation_time;
+    set_ai_wait(state.ai_wait);
+    m_ai_state          = (AIState) state.ai_state;
+    m_animation_index   = state.animation_index;
+    m_is_active         = state.flags & STATE_ACTIVE;
+    m_is_jumping        = state.flags & STATE_JUMPING;
+    m_is_facing_right   = state.flags & STATE_FACING_RIGHT;
+    m_collided_top      = state.flags & STATE_COLLIDED_TOP;
+    m_collided_bottom   = state.flags & STATE_COLLIDED_BOTTOM;
+    m_collided_right    = state.flags & STATE_COLLIDED_RIGHT;
+    m_collided_left     = state.flags & STATE_COLLIDED_LEFT;
+    m_gap_bottom_left   = state.flags & STATE_GAP_BOTTOM_LEFT;
+    m_gap_bottom_right  = state.flags & STATE_GAP_BOTTOM_RIGHT;
+    
+    // Derived from the rest, so it isn't saved
+    m_model_matrix = get_model_matrix(1.0f);
+}
+
@@ -10,20 +10,68 @@
 #define ENTITY_H
 
 #include "Map.hpp"
+#include "SpatialGrid.hpp"
 
 using namespace glm;
 
 enum EntityType { PLATFORM, PLAYER, ENEMY };
-enum AIType     { WALKER, GUARD, JUMPER };
+enum AIType     { WALKER, GUARD, JUMPER, SCRIPTED };  // SCRIPTED: moved by a Script instead
 enum AIState    { WALKING, IDLE, ATTACKING };
 
 //enum AnimationDirection { LEFT, RIGHT };
 
+// Everything needed to draw an entity, copied out at the end of a fixed step
+struct SpriteSnapshot {
+    GLuint  texture_id;
+    int     sprite_index = -1,  // -1 draws the whole texture
+            animation_cols,
+            animation_rows;
+    vec3    previous_position,
+            current_position,
+            scale_factor;
+    bool    is_facing_right;
+
+    vec3 const get_interpolated_pos(float alpha) const { return mix(previous_position, current_position, alpha); }
+    mat4 const get_model_matrix(float alpha) const;
+    Bounds const get_bounds(float alpha) const;
+};
+
+// Everything about an entity that changes while the game runs, as plain bytes,
+// so a whole scene can be saved and restored with a memcpy per entity (see StateHistory)
+struct EntityState {
+    vec3    position,
+            previous_position,
+            velocity,
+            movement;
+    float   animation_time;
+    Sint32  ai_wait;            // 32 bits so there's no padding to leave uninitialised
+    Uint8   ai_state,
+            animation_index;
+    Uint16  flags;              // EntityStateFlags
+};
+
+enum EntityStateFlags {
+    STATE_ACTIVE            = 1 << 0,
+    STATE_JUMPING           = 1 << 1,
+    STATE_FACING_RIGHT      = 1 << 2,
+    STATE_COLLIDED_TOP      = 1 << 3,
+    STATE_COLLIDED_BOTTOM   = 1 << 4,
+    STATE_COLLIDED_RIGHT    = 1 << 5,
+    STATE_COLLIDED_LEFT     = 1 << 6,
+    STATE_GAP_BOTTOM_LEFT   = 1 << 7,
+    STATE_GAP_BOTTOM_RIGHT  = 1 << 8
+};
+
 class Entity {
 private:
     EntityType m_entity_type;
-    AIType m_ai_type;
-    AIState m_ai_state;
+    // Set for the player too, since they're part of its saved state (see EntityState)
+    AIType m_ai_type = WALKER;
+    AIState m_ai_state = IDLE;
+    // The step, on the AIScheduler's clock, of this one's next decision. Without a
+    // scheduler (no clock) it decides for itself every update
+    int m_ai_due = 0;
+    const int *m_ai_clock = nullptr;
     
     bool m_is_active = true;
     
@@ -34,6 +82,7 @@ private:
     
     vec3    m_movement,
             m_position,
+            m_previous_position,    // where the last fixed step started, for interpolation
             m_scale,
             m_velocity,
             m_acceleration;
@@ -43,7 +92,7 @@ private:
     float   m_speed,
             m_jumping_power;
     
-    bool    m_is_jumping;
+    bool    m_is_jumping = false;
     bool    m_is_facing_right;
     
     /* ----- ANIMATION/TEXTURES ----- */
@@ -73,6 +122,8 @@ private:
 public:
     /* ----- STATIC VARIABLES ----- */
     static constexpr int FRAMES_PER_SECOND = 4;
+    // The collision and kill-off messages; batch runs turn them off (see BatchEnv)
+    static bool s_log_events;
     
     /* ----- METHODS ----- */
     Entity();
@@ -87,25 +138,43 @@ public:
            float size, EntityType entity_type, AIType ai_type, AIState ai_state);
     ~Entity();
     
-    void draw_sprite_from_texture_atlas(ShaderProgram *program, int index) const;
+    void draw_sprite_from_texture_atlas(ShaderProgram *program, int index,
+                                        const mat4 &model_matrix) const;
+    static void draw_sprite(ShaderProgram *program, GLuint texture_id, int animation_cols,
+                            int animation_rows, int index, const mat4 &model_matrix);
     
     bool const check_collision(Entity *other) const;
     
     void check_collision_y(Map *map);
     void check_collision_x(Map *map);
     
-    void check_collision_y(std::vector<Entity*> objects, int object_count);
-    void check_collision_x(std::vector<Entity*> objects, int object_count);
+    void check_collision_y(const std::vector<Entity*> &objects, int object_count);
+    void check_collision_x(const std::vector<Entity*> &objects, int object_count);
     
     void check_platform_x(Map *map, float delta_x);
     
+    // objects by reference: this runs for every entity every step, and again for
+    // every step a rollback re-runs, so it mustn't allocate
     void update(Map *map, float delta_time = 0.0f,  Entity *player = nullptr,
-                std::vector<Entity*> objects = std::vector<Entity*>(), int object_count = 0);
-    void render(ShaderProgram *program);
+                const std::vector<Entity*> &objects = std::vector<Entity*>(), int object_count = 0);
+    // alpha is how far we are between the last two fixed steps (0 = previous, 1 = current)
+    void render(ShaderProgram *program, float alpha = 1.0f);
+    mat4 const get_model_matrix(float alpha) const;
+    // The sprite's quad in world space, at the same interpolated position render() uses
+    Bounds const get_bounds(float alpha = 1.0f) const;
+    
+    SpriteSnapshot const get_snapshot() const;
+    // Draws from a copy, so the render thread never has to touch a live Entity
+    static void render_snapshot(ShaderProgram *program, const SpriteSnapshot &snapshot, float alpha);
     
+    // Steering every update, plus the decision too unless an AIScheduler makes those
     void ai_activate(Entity *player);
+    void ai_steer();
+    // The part worth spreading out; returns how far away the player is
+    float ai_decide(Entity *player);
+    bool const has_ai_decisions() const { return m_ai_type == GUARD; }
     void ai_walk();
-    void ai_guard(Entity *player);
+    void ai_guard(Entity *player, float player_distance);
     void ai_jump();
     
     void normalize_movement() { m_movement = normalize(m_movement); }
@@ -120,6 +189,9 @@ public:
     void kill_off();
     void reset(Map *map, vec3 pos);
     
+    EntityState const save_state() const;
+    void load_state(const EntityState &state);
+    
     void init_anim();
     void add_anim_time(const float delta_time) { m_animation_time += delta_time; };
     void anim_iterate() { m_animation_index++; };
@@ -128,23 +200,36 @@ public:
     EntityType const get_entity_type()  const { return m_entity_type; }
     AIType const get_ai_type()          const { return m_ai_type; }
     AIState const get_ai_state()        const { return m_ai_state; }
+    // Steps until the next decision; negative once overdue
+    int const get_ai_wait()             const { return m_ai_due - (m_ai_clock ? *m_ai_clock : 0); }
+    int const get_ai_due()              const { return m_ai_due; }
     GLuint const get_tex_id()           const { return m_texture_id; }
     vec3 const get_pos()        const { return m_position; }
+    vec3 const get_previous_pos()       const { return m_previous_position; }
+    vec3 const get_interpolated_pos(float alpha) const { return mix(m_previous_position, m_position, alpha); }
     vec3 const get_vel()        const { return m_velocity; }
     vec3 const get_accel()      const { return m_acceleration; }
     vec3 const get_mov()        const { return m_movement; }
     vec3 const get_scale()      const { return m_scale; }
     float const get_speed()     const { return m_speed; }
     bool const get_active_state()       const { return m_is_active; }
+    bool const get_facing_right()       const { return m_is_facing_right; }
+    int const get_anim_index()          const { return m_animation_index; }
     bool const get_collided_top()       const { return m_collided_top; }
     bool const get_collided_bottom()    const { return m_collided_bottom; }
     bool const get_collided_right()     const { return m_collided_right; }
     bool const get_collided_left()      const { return m_collided_left; }
+    bool const get_gap_bottom_left()    const { return m_gap_bottom_left; }
+    bool const get_gap_bottom_right()   const { return m_gap_bottom_right; }
     
     /* ————— SETTERS ————— */
     void set_ai_type(AIType type)       { m_ai_type = type; }
     void set_ai_state(AIState state)    { m_ai_state = state; }
-    void set_pos(vec3 pos)              { m_position = pos; }
+    void set_ai_wait(int steps)         { m_ai_due = steps + (m_ai_clock ? *m_ai_clock : 0); }
+    void set_ai_due(int step)           { m_ai_due = step; }
+    // Keeps the countdown it had on the old clock
+    void set_ai_clock(const int *clock) { int wait = get_ai_wait(); m_ai_clock = clock; set_ai_wait(wait); }
+    void set_pos(vec3 pos)              { m_position = pos; m_previous_position = pos; }
     void set_vel(vec3 vel)              { m_velocity = vel; }
     void set_accel(vec3 accel)          { m_acceleration = accel; }
     void set_mov(vec3 mov)              { m_movement = mov; }
@@ -158,6 +243,16 @@ public:
     void set_anim_time(int time)        { m_animation_time = time; }
     void set_size(float size)           { m_size = size; }
     
+    // A copy driven by someone else's simulation (see SnapshotClient): just what's
+    // needed to draw it, moving on from where it was so it still interpolates
+    void apply_replica(vec3 pos, bool facing_right, int anim_index) {
+        m_previous_position = m_is_active ? m_position : pos;
+        m_position = pos;
+        m_is_facing_right = facing_right;
+        m_animation_index = anim_index;
+        m_is_active = true;
+    }
+    
     // specific to this tilemap
 //    void set_walking(int walking)
     
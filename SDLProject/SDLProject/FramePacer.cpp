@@ -0,0 +1,128 @@
+// FramePacer.cpp
+#define LOG(argument) std::cout << argument << '\n'
+
+#include "FramePacer.hpp"
+#include <iostream>
+#include <cmath>
+
+FramePacer::FramePacer(PacingMode mode, int target_fps) :
+m_mode(mode), m_target_fps(target_fps) {
+    m_frequency     = SDL_GetPerformanceFrequency();
+    m_frame_start   = SDL_GetPerformanceCounter();
+    m_next_deadline = m_frame_start;
+}
+
+void FramePacer::set_mode(PacingMode mode) {
+    m_mode = mode;
+
+    if (m_mode == VSYNC and SDL_GL_SetSwapInterval(1) != 0) {
+        // Some drivers (and most software GL) won't do vsync; a cap gets us most of the way
+        LOG("Vsync unavailable (" << SDL_GetError() << "), capping to " << m_target_fps << " fps.");
+        m_mode = CAPPED;
+    }
+    if (m_mode != VSYNC) SDL_GL_SetSwapInterval(0);
+
+    // Start timing from here, so whatever ran before (e.g. loading) isn't one giant frame
+    m_frame_start   = SDL_GetPerformanceCounter();
+    m_next_deadline = m_frame_start;
+    LOG("Frame pacing: " << mode_name(m_mode));
+}
+
+void FramePacer::set_target_fps(int fps) {
+    m_target_fps = fps > 0 ? fps : 60;
+}
+
+void FramePacer::begin_frame() {
+    Uint64 now = SDL_GetPerformanceCounter();
+    m_delta_time  = (float) (now - m_frame_start) / (float) m_frequency;
+    m_frame_start = now;
+
+    m_frame_times_ms[m_frame_count % STATS_WINDOW] = m_delta_time * 1000.0f;
+    m_frame_count++;
+
+    if (not m_log_stats) return;
+    m_time_since_log += m_delta_time;
+    if (m_time_since_log >= STATS_LOG_INTERVAL) {
+        m_time_since_log = 0.0f;
+        log_stats();
+    }
+}
+
+void FramePacer::end_frame() {
+    if (m_mode != CAPPED) return;
+
+    Uint64 period = m_frequency / m_target_fps;
+    m_next_deadline += period;
+
+    // If we've fallen a whole frame behind, don't try to catch up with a burst
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (now > m_next_deadline + period) m_next_deadline = now;
+
+    wait_until(m_next_deadline);
+}
+
+void FramePacer::wait_until(Uint64 deadline) const {
+    // Sleep through the bulk of the wait, then spin the last stretch for accuracy
+    while (true) {
+        Uint64 now = SDL_GetPerformanceCounter();
+        if (now >= deadline) return;
+
+        float remaining_ms = counter_to_ms(deadline - now);
+        if (remaining_ms > SPIN_MARGIN_MS)
+            SDL_Delay((Uint32) (remaining_ms - SPIN_MARGIN_MS));
+    }
+}
+
+int const FramePacer::get_sample_count() const {
+    return m_frame_count < STATS_WINDOW ? m_frame_count : STATS_WINDOW;
+}
+
+float const FramePacer::get_min_ms() const {
+    int count = get_sample_count();
+    if (count == 0) return 0.0f;
+    float min = m_frame_times_ms[0];
+    for (int i = 1; i < count; i++) if (m_frame_times_ms[i] < min) min = m_frame_times_ms[i];
+    return min;
+}
+
+float const FramePacer::get_max_ms() const {
+    int count = get_sample_count();
+    float max = 0.0f;
+    for (int i = 0; i < count; i++) if (m_frame_times_ms[i] > max) max = m_frame_times_ms[i];
+    return max;
+}
+
+float const FramePacer::get_avg_ms() const {
+    int count = get_sample_count();
+    if (count == 0) return 0.0f;
+    float sum = 0.0f;
+    for (int i = 0; i < count; i++) sum += m_frame_times_ms[i];
+    return sum / count;
+}
+
+float const FramePacer::get_jitter_ms() const {
+    int count = get_sample_count();
+    if (count == 0) return 0.0f;
+    float avg = get_avg_ms();
+    float sum = 0.0f;
+    for (int i = 0; i < count; i++)
+        sum += (m_frame_times_ms[i] - avg) * (m_frame_times_ms[i] - avg);
+    return sqrtf(sum / count);
+}
+
+void FramePacer::log_stats() const {
+    LOG("[" << mode_name(m_mode) << "] frame ms"
+        << " min " << get_min_ms()
+        << " avg " << get_avg_ms()
+        << " max " << get_max_ms()
+        << " jitter " << get_jitter_ms());
+}
+
+const char *FramePacer::mode_name(PacingMode mode) {
+    switch (mode) {
+        case VSYNC:     return "vsync";
+        case CAPPED:    return "capped";
+        case UNCAPPED:  return "uncapped";
+        default:        return "unknown";
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+#pragma once
+#include <SDL.h>
+
+enum PacingMode { VSYNC, CAPPED, UNCAPPED };
+
+// Paces the main loop off SDL's high-resolution counter instead of spinning.
+// VSYNC lets the driver block in SDL_GL_SwapWindow, CAPPED sleeps for most of the
+// remaining frame and spins only for the last couple of milliseconds, and
+// UNCAPPED runs as fast as it can (for benchmarking).
+class FramePacer {
+private:
+    static constexpr int   STATS_WINDOW        = 240;   // frames kept for the stats
+    static constexpr float SPIN_MARGIN_MS      = 2.0f;  // SDL_Delay is only ~1ms accurate
+    static constexpr float STATS_LOG_INTERVAL  = 5.0f;  // seconds
+
+    PacingMode m_mode;
+    int m_target_fps;
+
+    Uint64  m_frequency,
+            m_frame_start,
+            m_next_deadline;
+    float   m_delta_time = 0.0f;
+
+    float m_frame_times_ms[STATS_WINDOW];
+    int   m_frame_count = 0;
+    float m_time_since_log = 0.0f;
+    bool  m_log_stats = false;          // every STATS_LOG_INTERVAL, see --pacing-stats
+
+    void wait_until(Uint64 deadline) const;
+
+public:
+    FramePacer(PacingMode mode = VSYNC, int target_fps = 60);
+
+    // Applies the swap interval, so it needs a current GL context
+    void set_mode(PacingMode mode);
+    void set_target_fps(int fps);
+    void set_log_stats(bool log_stats) { m_log_stats = log_stats; }
+
+    // Call at the top of each frame; measures the time since the last one
+    void begin_frame();
+    // Call after the swap; in CAPPED mode waits until the next frame is due
+    void end_frame();
+
+    float      const get_delta_time()  const { return m_delta_time; }
+    PacingMode const get_mode()        const { return m_mode; }
+    int        const get_target_fps()  const { return m_target_fps; }
+    Uint64     const get_counter()     const { return SDL_GetPerformanceCounter(); }
+    float      const counter_to_ms(Uint64 ticks) const { return (float) ticks * 1000.0f / (float) m_frequency; }
+
+    /* ----- STATS (over the last STATS_WINDOW frames) ----- */
+    int   const get_sample_count() const;
+    float const get_min_ms() const;
+    float const get_max_ms() const;
+    float const get_avg_ms() const;
+    float const get_jitter_ms() const;  // standard deviation of the frame time
+    void log_stats() const;
+
+    static const char *mode_name(PacingMode mode);
+};
+
+#endif // FRAMEPACER_H
@@ -0,0 +1,234 @@
+// GLRenderer.cpp
+#define LOG(argument) std::cout << argument << '\n'
+
+#include "Renderer.hpp"
+#include <algorithm>
+#include <iostream>
+
+#define NUMBER_OF_TEXTURES 1
+#define LEVEL_OF_DETAIL 0
+#define TEXTURE_BORDER 0
+
+GLuint GLRenderer::upload_texture(const unsigned char *pixels, int width, int height) {
+    GLuint textureID;
+    glGenTextures(NUMBER_OF_TEXTURES, &textureID);
+
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexImage2D(GL_TEXTURE_2D, LEVEL_OF_DETAIL, GL_RGBA, width, height, TEXTURE_BORDER,
+                 GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    m_bound_texture = textureID;
+
+    TextureRegion region;
+    region.texture = textureID;
+    return add_region(region, true);
+}
+
+void GLRenderer::delete_texture(GLuint texture_id) {
+    GLuint texture = remove_region(texture_id);
+    if (texture == 0) return;
+    if (texture == m_bound_texture) m_bound_texture = 0;
+    glDeleteTextures(NUMBER_OF_TEXTURES, &texture);
+}
+
+void GLRenderer::submit_batches(const RenderQueue &queue) {
+    const float *vertices   = queue.get_batch_vertices(),
+                *tex_coords = queue.get_batch_tex_coords();
+    ShaderProgram *current_program = nullptr;
+
+    for (const RenderQueue::Batch &batch : queue.get_batches()) {
+        if (batch.program != current_program) {
+            if (current_program) {
+                glDisableVertexAttribArray(current_program->positionAttribute);
+                glDisableVertexAttribArray(current_program->texCoordAttribute);
+            }
+            current_program = batch.program;
+
+            // SetModelMatrix does a glUseProgram as well as the upload; the queue has
+            // already put the vertices in world space
+            current_program->SetModelMatrix(glm::mat4(1.0f));
+            m_stats.program_switches++;
+            m_stats.uniform_uploads++;
+
+            glEnableVertexAttribArray(current_program->positionAttribute);
+            glEnableVertexAttribArray(current_program->texCoordAttribute);
+        }
+
+        if (batch.texture != m_bound_texture) {
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, batch.texture);
+            m_bound_texture = batch.texture;
+            m_stats.texture_binds++;
+        }
+
+        glVertexAttribPointer(current_program->positionAttribute, 2, GL_FLOAT, false, 0,
+                              vertices + batch.first_vertex * 2);
+        glVertexAttribPointer(current_program->texCoordAttribute, 2, GL_FLOAT, false, 0,
+                              tex_coords + batch.first_vertex * 2);
+
+        glDrawArrays(GL_TRIANGLES, 0, batch.vertex_count);
+        m_stats.draw_calls++;
+        m_stats.vertices += batch.vertex_count;
+    }
+
+    if (current_program) {
+        glDisableVertexAttribArray(current_program->positionAttribute);
+        glDisableVertexAttribArray(current_program->texCoordAttribute);
+    }
+}
+
+void GLRenderer::apply_projection_matrix(ShaderProgram *program, const glm::mat4 &projection_matrix) {
+    program->SetProjectionMatrix(projection_matrix);
+    m_stats.program_switches++;
+    m_stats.uniform_uploads++;
+}
+
+void GLRenderer::apply_view_matrix(ShaderProgram *program, const glm::mat4 &view_matrix) {
+    program->SetViewMatrix(view_matrix);
+    m_stats.program_switches++;
+    m_stats.uniform_uploads++;
+}
+
+GLRenderer::~GLRenderer() {
+    if (m_framebuffer == 0) return;
+    glDeleteFramebuffers(1, &m_framebuffer);
+    glDeleteTextures(NUMBER_OF_TEXTURES, &m_target_texture);
+}
+
+void GLRenderer::set_resolution_mode(ResolutionMode mode, int native_width, int native_height,
+                                     float frame_budget_ms) {
+    m_resolution_mode   = mode;
+    m_native_width      = native_width;
+    m_native_height     = native_height;
+    m_frame_budget_ms   = frame_budget_ms;
+    m_dynamic_level     = 1.0f;
+    m_late_frames       = 0;
+    m_on_time_frames    = 0;
+}
+
+void GLRenderer::resize_target(int width, int height) {
+    if (width == m_target_width and height == m_target_height) return;
+    m_target_width  = width;
+    m_target_height = height;
+
+    if (m_framebuffer == 0) {
+        glGenFramebuffers(1, &m_framebuffer);
+        glGenTextures(NUMBER_OF_TEXTURES, &m_target_texture);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, m_target_texture);
+    m_bound_texture = m_target_texture;
+    glTexImage2D(GL_TEXTURE_2D, LEVEL_OF_DETAIL, GL_RGBA, width, height, TEXTURE_BORDER,
+                 GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_target_texture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        LOG("Low-res framebuffer incomplete, drawing at full resolution.");
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        m_resolution_mode = FULL_RESOLUTION;
+    }
+}
+
+void GLRenderer::clear() {
+    SDL_GL_GetDrawableSize(m_window, &m_window_width, &m_window_height);
+
+    int width  = m_window_width,
+        height = m_window_height;
+    if (m_resolution_mode == PIXEL_PERFECT) {
+        width  = m_native_width;
+        height = m_native_height;
+    }
+    else if (m_resolution_mode == DYNAMIC_RESOLUTION) {
+        width  = (int) (m_native_width  + (m_window_width  - m_native_width)  * m_dynamic_level);
+        height = (int) (m_native_height + (m_window_height - m_native_height) * m_dynamic_level);
+    }
+
+    if (m_resolution_mode != FULL_RESOLUTION) resize_target(width, height);
+
+    // resize_target can fall back to full resolution if the driver says no
+    if (m_resolution_mode == FULL_RESOLUTION) {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, m_window_width, m_window_height);
+        m_stats.target_width  = m_window_width;
+        m_stats.target_height = m_window_height;
+    }
+    else {
+        glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+        glViewport(0, 0, width, height);
+        m_stats.target_width  = width;
+        m_stats.target_height = height;
+        m_resolved = false;
+    }
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void GLRenderer::resolve_target() {
+    if (m_resolved) return;
+    m_resolved = true;
+
+    // Whole-number scale for pixel-perfect, otherwise stretch (the aspect ratio matches)
+    int width  = m_window_width,
+        height = m_window_height;
+    if (m_resolution_mode == PIXEL_PERFECT) {
+        int scale = std::max(1, std::min(m_window_width / m_target_width,
+                                         m_window_height / m_target_height));
+        width  = m_target_width  * scale;
+        height = m_target_height * scale;
+    }
+    int x = (m_window_width  - width)  / 2,
+        y = (m_window_height - height) / 2;
+
+    // The letterbox bars just get the background colour
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, m_window_width, m_window_height);
+    if (width != m_window_width or height != m_window_height) glClear(GL_COLOR_BUFFER_BIT);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+    glBlitFramebuffer(0, 0, m_target_width, m_target_height,
+                      x, y, x + width, y + height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void GLRenderer::begin_overlay() {
+    flush();
+    resolve_target();
+}
+
+void GLRenderer::update_dynamic_level() {
+    Uint64 now = SDL_GetPerformanceCounter();
+    float frame_ms = (float) (now - m_last_present) * 1000.0f / (float) SDL_GetPerformanceFrequency();
+    bool first_frame = m_last_present == 0;
+    m_last_present = now;
+    if (first_frame or m_resolution_mode != DYNAMIC_RESOLUTION) return;
+
+    // Drop quickly when we start missing frames, creep back up slowly once we stop
+    if (frame_ms > m_frame_budget_ms * DYNAMIC_LATE_FACTOR) {
+        m_on_time_frames = 0;
+        if (++m_late_frames >= DYNAMIC_LATE_FRAMES and m_dynamic_level > 0.0f) {
+            m_dynamic_level = std::max(0.0f, m_dynamic_level - DYNAMIC_STEP);
+            m_late_frames = 0;
+        }
+    }
+    else {
+        m_late_frames = 0;
+        if (++m_on_time_frames >= DYNAMIC_RECOVER_FRAMES and m_dynamic_level < 1.0f) {
+            m_dynamic_level = std::min(1.0f, m_dynamic_level + DYNAMIC_STEP);
+            m_on_time_frames = 0;
+        }
+    }
+}
+
+void GLRenderer::present() {
+    flush();
+    resolve_target();
+    finish_frame_stats();
+    SDL_GL_SwapWindow(m_window);
+    update_dynamic_level();
+}
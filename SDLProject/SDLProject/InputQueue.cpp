@@ -0,0 +1,85 @@
+// InputQueue.cpp
+#define LOG(argument) std::cout << argument << '\n'
+
+#include "InputQueue.hpp"
+#include <algorithm>
+#include <iostream>
+
+constexpr float MILLISECONDS_IN_SECOND = 1000.0f;
+
+void InputQueue::push(InputAction action, bool pressed, Uint64 timestamp) {
+    if (m_sent_held[action] == pressed) return;
+
+    // If the simulation has stalled long enough to fill the queue, losing a key
+    // is the least bad option; sync() will put held keys right again
+    if (not m_events.push({ action, pressed, timestamp })) {
+        LOG("Input queue full, dropped an event.");
+        return;
+    }
+    m_sent_held[action] = pressed;
+}
+
+void InputQueue::sync(InputAction action, bool held, Uint64 now) {
+    push(action, held, now);
+}
+
+StepInput InputQueue::take_step(Uint64 step_end) {
+    bool pressed[ACTION_COUNT] = { false };
+    Uint64 now = SDL_GetPerformanceCounter();
+    float ticks_to_ms = MILLISECONDS_IN_SECOND / (float) SDL_GetPerformanceFrequency();
+
+    while (true) {
+        if (not m_has_next) {
+            if (not m_events.pop(m_next)) break;
+            m_has_next = true;
+        }
+        // Anything later belongs to a step we haven't got to yet
+        if (m_next.timestamp >= step_end) break;
+        m_has_next = false;
+
+        m_held[m_next.action] = m_next.pressed;
+        if (m_next.pressed) pressed[m_next.action] = true;
+        record_latency(now > m_next.timestamp ? (float) (now - m_next.timestamp) * ticks_to_ms : 0.0f);
+    }
+
+    // A tap that starts and ends inside one step still moves the player for it
+    StepInput input;
+    input.left  = m_held[ACTION_LEFT]  or pressed[ACTION_LEFT];
+    input.right = m_held[ACTION_RIGHT] or pressed[ACTION_RIGHT];
+    input.jump  = pressed[ACTION_JUMP];
+    input.start = pressed[ACTION_START];
+    input.rewind = m_held[ACTION_REWIND] or pressed[ACTION_REWIND];
+    return input;
+}
+
+void InputQueue::record_latency(float latency_ms) {
+    std::lock_guard<std::mutex> lock(m_latency_mutex);
+    m_latencies_ms[m_latency_next] = latency_ms;
+    m_latency_next = (m_latency_next + 1) % LATENCY_WINDOW;
+    if (m_latency_count < LATENCY_WINDOW) m_latency_count++;
+}
+
+InputLatency InputQueue::get_latency() const {
+    std::lock_guard<std::mutex> lock(m_latency_mutex);
+    InputLatency latency;
+    latency.events = m_latency_count;
+    if (m_latency_count == 0) return latency;
+
+    float total = 0.0f;
+    for (int i = 0; i < m_latency_count; i++) {
+        total += m_latencies_ms[i];
+        latency.max_ms = std::max(latency.max_ms, m_latencies_ms[i]);
+    }
+    latency.average_ms = total / m_latency_count;
+    return latency;
+}
+
+Uint64 InputQueue::to_counter(Uint32 event_ticks) {
+    Uint64 now   = SDL_GetPerformanceCounter();
+    Uint32 ticks = SDL_GetTicks();
+    // Events can't come from the future; clamp in case the two clocks disagree slightly
+    if (event_ticks >= ticks) return now;
+
+    Uint64 age = (Uint64) (ticks - event_ticks) * SDL_GetPerformanceFrequency() / 1000;
+    return age < now ? now - age : 0;
+}
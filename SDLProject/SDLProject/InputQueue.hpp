@@ -0,0 +1,78 @@
+#ifndef INPUTQUEUE_H
+#define INPUTQUEUE_H
+
+#pragma once
+#include <SDL.h>
+#include <mutex>
+#include "SPSCQueue.hpp"
+
+enum InputAction { ACTION_LEFT, ACTION_RIGHT, ACTION_JUMP, ACTION_START, ACTION_REWIND, ACTION_COUNT };
+
+struct InputEvent {
+    InputAction action;
+    bool        pressed;
+    Uint64      timestamp;      // performance counter
+};
+
+// What one fixed step sees. Movement and rewind are whatever was held at any
+// point during the step; jump and start are set if they were pressed during it
+struct StepInput {
+    bool    left    = false,
+            right   = false,
+            jump    = false,
+            start   = false,
+            rewind  = false;
+};
+
+// How long events wait between happening and a fixed step acting on them
+struct InputLatency {
+    float   average_ms  = 0.0f,
+            max_ms      = 0.0f;
+    int     events      = 0;    // in the window the numbers cover
+};
+
+// Carries input from the thread that polls SDL to the simulation, with each
+// event stamped with when it actually happened. Each fixed step takes exactly
+// the events from its own slice of time, so a tap during a slow frame still
+// lands on the right step, and catching up replays input step by step instead
+// of applying one frame's worth to all of them.
+class InputQueue {
+public:
+    static constexpr int LATENCY_WINDOW = 64;   // events
+
+private:
+    static constexpr int QUEUE_SIZE = 256;
+
+    SPSCQueue<InputEvent, QUEUE_SIZE> m_events;
+
+    /* ----- POLLING THREAD ----- */
+    bool m_sent_held[ACTION_COUNT] = { false };
+
+    /* ----- SIMULATION THREAD ----- */
+    bool m_held[ACTION_COUNT] = { false };
+    InputEvent m_next;                          // popped, but belongs to a later step
+    bool m_has_next = false;
+
+    mutable std::mutex m_latency_mutex;
+    float m_latencies_ms[LATENCY_WINDOW];
+    int m_latency_count = 0,
+        m_latency_next  = 0;
+
+    void record_latency(float latency_ms);
+
+public:
+    // Polling thread. Repeats and no-change events are dropped
+    void push(InputAction action, bool pressed, Uint64 timestamp);
+    // Catches up with the keyboard state, for releases SDL never sent (e.g. on focus loss)
+    void sync(InputAction action, bool held, Uint64 now);
+
+    // Simulation thread: everything that happened before step_end (performance counter)
+    StepInput take_step(Uint64 step_end);
+
+    InputLatency get_latency() const;
+
+    // SDL stamps events in SDL_GetTicks milliseconds; this puts them on the performance counter
+    static Uint64 to_counter(Uint32 event_ticks);
+};
+
+#endif // INPUTQUEUE_H
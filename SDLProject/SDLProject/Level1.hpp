@@ -12,7 +12,6 @@ public:
     ~Level1();
     void initialise() override;
     void update(float delta_time) override;
-    void render(ShaderProgram *program) override;
 };
 
 #endif // LEVEL1_H
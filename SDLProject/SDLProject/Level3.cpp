@@ -23,8 +23,6 @@ Level3::~Level3() {
     m_game_state.enemies.clear();
     delete    m_game_state.player;
     delete    m_game_state.map;
-    Mix_FreeChunk(m_game_state.jump_sfx);
-    Mix_FreeMusic(m_game_state.bgm);
 }
 
 void Level3::initialise() {
@@ -57,15 +55,6 @@ void Level3::initialise() {
     }
     m_game_state.enemies[0]->set_pos(glm::vec3(13.0f, -3.0f, 0.0f));
     m_game_state.enemies[0]->update(m_game_state.map);
-
-
-    Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 4096);
-//    
-//    m_game_state.bgm = Mix_LoadMUS(BGM_FILEPATH);
-//    Mix_PlayMusic(m_game_state.bgm, -1);
-//    Mix_VolumeMusic(0.0f);
-    
-    m_game_state.jump_sfx = Mix_LoadWAV(JUMP_SFX_FILEPATH);
 }
 
 void Level3::update(float delta_time) {
@@ -73,24 +62,12 @@ void Level3::update(float delta_time) {
     m_game_state.player->update(m_game_state.map, delta_time, nullptr,
                                 m_game_state.enemies, ENEMY_COUNT);
     
-    if (not m_game_state.player->get_active_state() and *g_lives > 0) {
-        m_game_state.player->reset(m_game_state.map, vec3(1.0f, -3.0f, 0.0f));
-        m_game_state.enemies[0]->reset(m_game_state.map, vec3(13.0f, -3.0f, 0.0f));
-        (*g_lives) --;
-    }
+    if (not m_game_state.player->get_active_state() and *g_lives > 0) respawn();
     
+    m_ai.schedule(m_game_state.enemies, m_game_state.player);
     for (int i = 0; i < ENEMY_COUNT; i++) {
         if (m_game_state.enemies[i]->get_active_state())
             m_game_state.enemies[i]->update(m_game_state.map, delta_time, m_game_state.player);
     }
     
 }
-
-
-void Level3::render(ShaderProgram *g_shader_program) {
-    m_game_state.map->render(g_shader_program);
-    m_game_state.player->render(g_shader_program);
-    for (int i = 0; i < m_number_of_enemies; i++)
-            m_game_state.enemies[i]->render(g_shader_program);
-
-}
@@ -13,7 +13,6 @@ public:
     
     void initialise() override;
     void update(float delta_time) override;
-    void render(ShaderProgram *program) override;
 };
 
 #endif // LEVEL3_H
@@ -1,5 +1,7 @@
 // Map.cpp
 #include "Map.hpp"
+#include "Renderer.hpp"
+#include "Profiler.hpp"
 
 Map::Map(int width, int height, unsigned int *level_data, GLuint texture_id,
          float tile_size, int tile_count_x, int tile_count_y) {
@@ -17,6 +19,10 @@ Map::Map(int width, int height, unsigned int *level_data, GLuint texture_id,
 }
 
 void Map::build() {
+    PROFILE_SCOPE("Map::build");
+    // The tileset may be packed into an atlas page, so every UV goes through this
+    TextureRegion region = Renderer::get()->get_region(m_texture_id);
+    
     // Since this is a 2D map, we need a nested for-loop
     for(int y_coord = 0; y_coord < m_height; y_coord++) {
         for(int x_coord = 0; x_coord < m_width; x_coord++) {
@@ -47,13 +53,18 @@ void Map::build() {
                 x_offset + (m_tile_size * x_coord) + m_tile_size, y_offset +  -m_tile_size * y_coord
             });
             
+            float u_left   = region.map_u(u_coord),
+                  u_right  = region.map_u(u_coord + tile_width),
+                  v_top    = region.map_v(v_coord),
+                  v_bottom = region.map_v(v_coord + tile_height);
+            
             m_tex_coords.insert(m_tex_coords.end(), {
-                u_coord, v_coord,
-                u_coord, v_coord + (tile_height),
-                u_coord + tile_width, v_coord + (tile_height),
-                u_coord, v_coord,
-                u_coord + tile_width, v_coord + (tile_height),
-                u_coord + tile_width, v_coord
+                u_left, v_top,
+                u_left, v_bottom,
+                u_right, v_bottom,
+                u_left, v_top,
+                u_right, v_bottom,
+                u_right, v_top
             });
         }
     }
@@ -66,21 +77,12 @@ void Map::build() {
 }
 
 void Map::render(ShaderProgram *program) {
+    PROFILE_SCOPE("Map::render");
     glm::mat4 model_matrix = glm::mat4(1.0f);
-    program->SetModelMatrix(model_matrix);
-    
-    glUseProgram(program->programID);
-    
-    glVertexAttribPointer(program->positionAttribute, 2, GL_FLOAT, false, 0, m_vertices.data());
-    glEnableVertexAttribArray(program->positionAttribute);
-    glVertexAttribPointer(program->texCoordAttribute, 2, GL_FLOAT, false, 0, m_tex_coords.data());
-    glEnableVertexAttribArray(program->texCoordAttribute);
-    
-    glBindTexture(GL_TEXTURE_2D, m_texture_id);
     
-    glDrawArrays(GL_TRIANGLES, 0, (int) m_vertices.size() / 2);
-    glDisableVertexAttribArray(program->positionAttribute);
-    glDisableVertexAttribArray(program->texCoordAttribute);
+    Renderer::get()->draw_triangles(program, m_texture_id, model_matrix,
+                                    m_vertices.data(), m_tex_coords.data(),
+                                    (int) m_vertices.size() / 2, LAYER_MAP);
 }
 
 bool Map::is_solid(glm::vec3 position, float *penetration_x, float *penetration_y) {
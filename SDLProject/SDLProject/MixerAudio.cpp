@@ -0,0 +1,76 @@
+// MixerAudio.cpp
+#define LOG(argument) std::cout << argument << '\n'
+
+#include "Audio.hpp"
+#include <SDL_mixer.h>
+#include <iostream>
+
+constexpr int   PLAY_ONCE   = 0;
+
+namespace {
+    class MixerSound : public Sound {
+    public:
+        Mix_Chunk *m_chunk;
+        MixerSound(Mix_Chunk *chunk) : m_chunk(chunk) {}
+        ~MixerSound() { Mix_FreeChunk(m_chunk); }
+    };
+
+    class MixerMusic : public Music {
+    public:
+        Mix_Music *m_music;
+        MixerMusic(Mix_Music *music) : m_music(music) {}
+        ~MixerMusic() { Mix_FreeMusic(m_music); }
+    };
+}
+
+bool MixerAudio::open() {
+    if (Mix_OpenAudio(m_frequency, MIX_DEFAULT_FORMAT, m_channels, m_buffer_size) < 0) {
+        LOG("Unable to open audio: " << SDL_GetError());
+        return false;
+    }
+    return true;
+}
+
+void MixerAudio::close() {
+    Mix_CloseAudio();
+}
+
+Sound *MixerAudio::load_sound(const char *filepath) {
+    Mix_Chunk *chunk = Mix_LoadWAV(filepath);
+    if (not chunk) return nullptr;
+    return new MixerSound(chunk);
+}
+
+Music *MixerAudio::load_music(const char *filepath) {
+    Mix_Music *music = Mix_LoadMUS(filepath);
+    if (not music) return nullptr;
+    return new MixerMusic(music);
+}
+
+void MixerAudio::set_voice_count(int count) {
+    Mix_AllocateChannels(count);
+}
+
+void MixerAudio::play_sound(Sound *sound, int voice, float volume) {
+    if (not sound) return;
+    // Mix_PlayChannel cuts off whatever the voice was playing, which is what stealing wants
+    Mix_Volume(voice, (int) (MIX_MAX_VOLUME * volume));
+    Mix_PlayChannel(voice, static_cast<MixerSound*>(sound)->m_chunk, PLAY_ONCE);
+}
+
+void MixerAudio::stop_voice(int voice) {
+    Mix_HaltChannel(voice);
+}
+
+bool const MixerAudio::is_voice_playing(int voice) const {
+    return Mix_Playing(voice) != 0;
+}
+
+void MixerAudio::play_music(Music *music, int loops) {
+    if (not music) return;
+    Mix_PlayMusic(static_cast<MixerMusic*>(music)->m_music, loops);
+}
+
+void MixerAudio::set_music_volume(float volume) {
+    Mix_VolumeMusic((int) (MIX_MAX_VOLUME * volume));
+}
@@ -0,0 +1,102 @@
+// NetGame.cpp
+#define LOG(argument) std::cout << argument << '\n'
+
+#include "NetGame.hpp"
+#include "AudioManager.hpp"
+#include <iostream>
+
+NetGame::NetGame(Transport *transport, int local_player, float timestep, bool play_sounds) :
+m_session(transport, local_player), m_timestep(timestep), m_play_sounds(play_sounds) {
+    m_session.set_callbacks([this] (std::vector<Uint8> &state) { m_scene->save_state(state); },
+                            [this] (const std::vector<Uint8> &state) { m_scene->load_state(state); },
+                            [this] (const StepInput inputs[RollbackSession::PLAYER_COUNT]) { step(inputs); });
+}
+
+void NetGame::set_scene(Scene *scene) {
+    m_scene = scene;
+    m_scene->add_partner(glm::vec3(1.0f, 0.0f, 0.0f));
+
+    int frame = m_session.get_frame();
+    m_session.restart(frame);
+    m_checked_through = frame;
+    m_end_frame = -1;
+}
+
+void NetGame::step(const StepInput inputs[RollbackSession::PLAYER_COUNT]) {
+    Entity *players[RollbackSession::PLAYER_COUNT] = { m_scene->m_game_state.player,
+                                                       m_scene->m_game_state.partner };
+    for (int i = 0; i < RollbackSession::PLAYER_COUNT; i++) {
+        bool jumped = Scene::move_player(players[i], inputs[i]);
+        // Steps that are being run again already made their noise the first time
+        if (jumped and m_play_sounds and not m_session.is_resimulating()) AudioManager::play(SFX_JUMP);
+    }
+
+    m_scene->update(m_timestep);
+    m_scene->update_partner(m_timestep);
+
+    if (m_scene->m_game_state.player->get_pos().y < -10.0f)
+        m_scene->m_game_state.player->kill_off();
+
+    m_scene->update_spatial_index();
+}
+
+NetGame::Outcome NetGame::advance(const StepInput &local_input) {
+    StepInput input = local_input;
+    input.jump = input.jump or m_pending.jump;
+
+    if (m_end_frame >= 0 and m_session.get_frame() >= m_end_frame) {
+        if (m_session.get_frame() > m_end_frame) LOG("Ran past the end of the level; the peers may have diverged.");
+
+        // Nothing can be left to roll back into the old level
+        m_session.poll();
+        if (m_session.get_confirmed_frame() < m_session.get_frame()) {
+            m_pending = input;
+            return WAITING;
+        }
+        m_pending = StepInput();
+        return m_end_lost ? GAME_LOST : LEVEL_CLEARED;
+    }
+
+    if (not m_session.advance(input)) {
+        m_pending = input;
+        return WAITING;
+    }
+    m_pending = StepInput();
+
+    check_progress();
+    return STEPPED;
+}
+
+void NetGame::check_progress() {
+    int confirmed = m_session.get_confirmed_frame();
+    while (m_end_frame < 0 and m_checked_through < confirmed) {
+        int frame = m_checked_through + 1;
+        if (not get_state(frame, m_scratch)) {
+            LOG("Lost track of confirmed state at frame " << frame << ".");
+            return;
+        }
+        m_checked_through = frame;
+
+        int lives, enemies_left;
+        if (not m_scene->read_progress(m_scratch, &lives, &enemies_left)) continue;
+        if (lives <= 0 or enemies_left == 0) {
+            m_end_frame = frame + END_DELAY;
+            m_end_lost = lives <= 0;
+        }
+    }
+}
+
+bool NetGame::get_state(int frame, std::vector<Uint8> &state) {
+    if (frame == m_session.get_frame()) {
+        m_scene->save_state(state);
+        return true;
+    }
+    const std::vector<Uint8> *saved = m_session.get_saved_state(frame);
+    if (not saved) return false;
+    state = *saved;
+    return true;
+}
+
+Entity *NetGame::get_local_entity() const {
+    return m_session.get_local_player() == 0 ? m_scene->m_game_state.player : m_scene->m_game_state.partner;
+}
@@ -0,0 +1,57 @@
+#ifndef NETGAME_H
+#define NETGAME_H
+
+#pragma once
+#include <SDL.h>
+#include <vector>
+#include "Rollback.hpp"
+#include "Scene.hpp"
+
+// One side of a two-player game: drives a RollbackSession with a scene's state and
+// steps, with player 0 as the scene's player and player 1 as its partner.
+//
+// Leaving a level can't be rolled back, so both sides have to do it on the same
+// step. Whether a level is over is only ever judged from confirmed states, which
+// are the same on both sides, and the switch happens END_DELAY steps after the
+// first confirmed state that says so; by then both sides are guaranteed to know.
+// The session waits there until every step before it is confirmed, so nothing
+// from the old level is left to roll back.
+class NetGame {
+public:
+    enum Outcome { STEPPED, WAITING, LEVEL_CLEARED, GAME_LOST };
+
+private:
+    static constexpr int END_DELAY = RollbackSession::MAX_ROLLBACK + 2;
+
+    RollbackSession m_session;
+    Scene *m_scene = nullptr;
+    float m_timestep;
+    bool m_play_sounds;
+
+    int  m_checked_through = 0,         // confirmed states looked at so far
+         m_end_frame = -1;              // when this level ends, once that's known
+    bool m_end_lost = false;
+
+    StepInput m_pending;                // a press that came in while we were waiting
+    std::vector<Uint8> m_scratch;
+
+    void step(const StepInput inputs[RollbackSession::PLAYER_COUNT]);
+    void check_progress();
+
+public:
+    NetGame(Transport *transport, int local_player, float timestep, bool play_sounds);
+
+    // A new level, ready and with its lives set: adds the partner and starts rolling
+    // back from here
+    void set_scene(Scene *scene);
+
+    Outcome advance(const StepInput &local_input);
+
+    // The state at the start of frame, whether it's saved or the live one
+    bool get_state(int frame, std::vector<Uint8> &state);
+
+    Entity *get_local_entity() const;
+    const RollbackSession &get_session() const { return m_session; }
+};
+
+#endif // NETGAME_H
@@ -0,0 +1,163 @@
+// Network.cpp
+#define LOG(argument) std::cout << argument << '\n'
+
+#include "Network.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WINDOWS
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#define close_socket closesocket
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#define close_socket close
+#endif
+
+constexpr float MILLISECONDS_IN_SECOND = 1000.0f;
+
+/* ----- UDP ----- */
+
+UdpTransport::UdpTransport(Uint16 local_port, Uint16 remote_port) : m_remote_port(remote_port) {
+#ifdef _WINDOWS
+    WSADATA wsa_data;
+    WSAStartup(MAKEWORD(2, 2), &wsa_data);
+#endif
+    m_socket = (int) socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (m_socket < 0) {
+        LOG("Unable to create a UDP socket.");
+        return;
+    }
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family      = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port        = htons(local_port);
+    if (bind(m_socket, (sockaddr *) &address, sizeof(address)) < 0) {
+        LOG("Unable to bind UDP port " << local_port << ".");
+        close_socket(m_socket);
+        m_socket = -1;
+        return;
+    }
+
+    // receive() is polled once a tick, so it must never wait
+#ifdef _WINDOWS
+    u_long non_blocking = 1;
+    ioctlsocket(m_socket, FIONBIO, &non_blocking);
+#else
+    fcntl(m_socket, F_SETFL, fcntl(m_socket, F_GETFL, 0) | O_NONBLOCK);
+#endif
+    LOG("Listening on UDP port " << local_port << ", peer on " << remote_port << ".");
+}
+
+UdpTransport::~UdpTransport() {
+    if (m_socket >= 0) close_socket(m_socket);
+}
+
+bool UdpTransport::send(const void *data, int length) {
+    if (m_socket < 0) return false;
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family      = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port        = htons(m_remote_port);
+    return sendto(m_socket, (const char *) data, length, 0, (sockaddr *) &address, sizeof(address)) == length;
+}
+
+int UdpTransport::receive(void *buffer) {
+    if (m_socket < 0) return 0;
+
+    // Anything that isn't from the peer's port is ignored
+    while (true) {
+        sockaddr_in from;
+        socklen_t from_length = sizeof(from);
+        int length = (int) recvfrom(m_socket, (char *) buffer, MAX_PACKET_SIZE, 0,
+                                    (sockaddr *) &from, &from_length);
+        if (length <= 0) return 0;
+        if (ntohs(from.sin_port) == m_remote_port) return length;
+    }
+}
+
+/* ----- LOOPBACK ----- */
+
+void LoopbackTransport::create_pair(LoopbackTransport **first, LoopbackTransport **second) {
+    std::shared_ptr<Channel> to_first  = std::make_shared<Channel>(),
+                             to_second = std::make_shared<Channel>();
+    *first  = new LoopbackTransport(to_first, to_second);
+    *second = new LoopbackTransport(to_second, to_first);
+}
+
+bool LoopbackTransport::send(const void *data, int length) {
+    if (length > MAX_PACKET_SIZE) return false;
+
+    const Uint8 *bytes = (const Uint8 *) data;
+    std::lock_guard<std::mutex> lock(m_outbox->mutex);
+    m_outbox->packets.push_back(std::vector<Uint8>(bytes, bytes + length));
+    return true;
+}
+
+int LoopbackTransport::receive(void *buffer) {
+    std::lock_guard<std::mutex> lock(m_inbox->mutex);
+    if (m_inbox->packets.empty()) return 0;
+
+    std::vector<Uint8> &packet = m_inbox->packets.front();
+    int length = (int) packet.size();
+    memcpy(buffer, packet.data(), length);
+    m_inbox->packets.pop_front();
+    return length;
+}
+
+/* ----- SIMULATED LATENCY ----- */
+
+LaggyTransport::LaggyTransport(Transport *inner, float latency_ms, float jitter_ms, float loss,
+                               Uint32 seed) :
+m_inner(inner), m_latency_ms(latency_ms), m_jitter_ms(jitter_ms), m_loss(loss),
+m_random(seed ? seed : 1), m_start_counter(SDL_GetPerformanceCounter()) { }
+
+double LaggyTransport::now_ms() const {
+    if (m_manual_clock) return m_clock_ms;
+    return (double) (SDL_GetPerformanceCounter() - m_start_counter) * MILLISECONDS_IN_SECOND
+           / (double) SDL_GetPerformanceFrequency();
+}
+
+// xorshift32, scaled to 0-1
+float LaggyTransport::next_random() {
+    m_random ^= m_random << 13;
+    m_random ^= m_random >> 17;
+    m_random ^= m_random << 5;
+    return (float) (m_random & 0xffffff) / (float) 0x1000000;
+}
+
+void LaggyTransport::flush() {
+    double now = now_ms();
+    // Few enough packets are ever in flight that a linear pass is fine
+    auto due = std::stable_partition(m_delayed.begin(), m_delayed.end(),
+                                     [now] (const Delayed &packet) { return packet.deliver_at_ms > now; });
+    for (auto packet = due; packet != m_delayed.end(); packet++)
+        m_inner->send(packet->data.data(), (int) packet->data.size());
+    m_delayed.erase(due, m_delayed.end());
+}
+
+bool LaggyTransport::send(const void *data, int length) {
+    flush();
+    if (next_random() < m_loss) return true;    // as far as the sender knows, it went
+
+    Delayed packet;
+    float jitter = (next_random() * 2.0f - 1.0f) * m_jitter_ms;
+    packet.deliver_at_ms = now_ms() + std::max(0.0f, m_latency_ms + jitter);
+    packet.data.assign((const Uint8 *) data, (const Uint8 *) data + length);
+    m_delayed.push_back(packet);
+    return true;
+}
+
+int LaggyTransport::receive(void *buffer) {
+    flush();
+    return m_inner->receive(buffer);
+}
@@ -0,0 +1,101 @@
+#ifndef NETWORK_H
+#define NETWORK_H
+
+#pragma once
+#include <SDL.h>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Unreliable, unordered datagrams to one peer, never blocking. Whatever sits on
+// top has to cope with packets going missing or turning up out of order
+class Transport {
+public:
+    static constexpr int MAX_PACKET_SIZE = 512;
+
+    virtual ~Transport() {}
+
+    virtual bool send(const void *data, int length) = 0;
+    // Copies the next waiting packet into buffer (MAX_PACKET_SIZE bytes); returns
+    // its length, or 0 if nothing has arrived
+    virtual int receive(void *buffer) = 0;
+};
+
+// UDP between two ports on this machine
+class UdpTransport : public Transport {
+private:
+    int m_socket = -1;
+    Uint16 m_remote_port;
+
+public:
+    UdpTransport(Uint16 local_port, Uint16 remote_port);
+    ~UdpTransport();
+
+    bool is_open() const { return m_socket >= 0; }
+
+    bool send(const void *data, int length) override;
+    int receive(void *buffer) override;
+};
+
+// Two ends of an in-process pipe, for running both peers in one process. Either
+// end can be used from its own thread
+class LoopbackTransport : public Transport {
+private:
+    struct Channel {
+        std::mutex mutex;
+        std::deque<std::vector<Uint8>> packets;
+    };
+
+    std::shared_ptr<Channel> m_inbox,
+                             m_outbox;
+
+    LoopbackTransport(std::shared_ptr<Channel> inbox, std::shared_ptr<Channel> outbox) :
+    m_inbox(inbox), m_outbox(outbox) { }
+
+public:
+    static void create_pair(LoopbackTransport **first, LoopbackTransport **second);
+
+    bool send(const void *data, int length) override;
+    int receive(void *buffer) override;
+};
+
+// Wraps another transport and makes it worse: every packet sent is held back for
+// latency plus or minus jitter (so they can arrive out of order), and a share of
+// them are dropped. Deterministic for a given seed.
+//
+// By default it runs off the real clock; headless runs that step faster than real
+// time can drive the clock themselves with advance_clock.
+class LaggyTransport : public Transport {
+private:
+    struct Delayed {
+        double deliver_at_ms;           // since the transport was made
+        std::vector<Uint8> data;
+    };
+
+    Transport *m_inner;                 // owned
+    float   m_latency_ms,
+            m_jitter_ms,
+            m_loss;                     // 0-1
+    Uint32  m_random;
+
+    Uint64  m_start_counter;            // so the real clock reads from 0, not from boot
+    bool    m_manual_clock = false;
+    double  m_clock_ms = 0.0;
+    std::vector<Delayed> m_delayed;
+
+    double now_ms() const;
+    float next_random();
+    void flush();
+
+public:
+    LaggyTransport(Transport *inner, float latency_ms, float jitter_ms, float loss, Uint32 seed);
+    ~LaggyTransport() { delete m_inner; }
+
+    void advance_clock(float delta_ms) { m_manual_clock = true; m_clock_ms += delta_ms; }
+
+    bool send(const void *data, int length) override;
+    int receive(void *buffer) override;
+};
+
+#endif // NETWORK_H
@@ -0,0 +1,73 @@
+// PerfOverlay.cpp
+#include "PerfOverlay.hpp"
+#include "Utility.hpp"
+#include <algorithm>
+#include <vector>
+#include <cstdio>
+
+constexpr float FONT_SIZE       = 0.18f,
+                FONT_SPACING    = 0.0f,
+                LINE_HEIGHT     = 0.22f;
+const glm::vec3 TOP_LEFT        = glm::vec3(-4.8f, 3.55f, 0.0f);
+
+void PerfOverlay::Series::add(float value) {
+    samples[next] = value;
+    next = (next + 1) % WINDOW;
+    if (count < WINDOW) count++;
+}
+
+float PerfOverlay::Series::min() const {
+    if (count == 0) return 0.0f;
+    return *std::min_element(samples, samples + count);
+}
+
+float PerfOverlay::Series::avg() const {
+    if (count == 0) return 0.0f;
+    float total = 0.0f;
+    for (int i = 0; i < count; i++) total += samples[i];
+    return total / count;
+}
+
+float PerfOverlay::Series::percentile(float fraction) const {
+    if (count == 0) return 0.0f;
+    std::vector<float> sorted(samples, samples + count);
+    int index = std::min(count - 1, (int) (fraction * count));
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    return sorted[index];
+}
+
+void PerfOverlay::add_frame(float frame_ms, const RenderStats &stats) {
+    m_frame_ms.add(frame_ms);
+    m_cpu_ms.add(stats.cpu_frame_ms);
+    m_last_stats = stats;
+}
+
+void PerfOverlay::render(ShaderProgram *program, GLuint font_texture_id,
+                         const glm::mat4 &view_matrix) const {
+    if (not m_visible) return;
+
+    // The counters are the previous frame's, so they include the overlay's own
+    // text (one batch) and two view matrix uploads
+    char lines[6][96];
+    float avg_frame = m_frame_ms.avg();
+    snprintf(lines[0], sizeof(lines[0]), "FPS %.0f  FRAME %.1f/%.1f/%.1f MS",
+             avg_frame > 0.0f ? 1000.0f / avg_frame : 0.0f,
+             m_frame_ms.min(), avg_frame, m_frame_ms.percentile(0.99f));
+    snprintf(lines[1], sizeof(lines[1]), "CPU %.2f/%.2f/%.2f MS (MIN/AVG/P99)",
+             m_cpu_ms.min(), m_cpu_ms.avg(), m_cpu_ms.percentile(0.99f));
+    snprintf(lines[2], sizeof(lines[2]), "CMDS %d  DRAWS %d  VERTS %d  BINDS %d",
+             m_last_stats.commands, m_last_stats.draw_calls, m_last_stats.vertices,
+             m_last_stats.texture_binds);
+    snprintf(lines[3], sizeof(lines[3]), "PROGRAMS %d  UNIFORMS %d  CULLED %d",
+             m_last_stats.program_switches, m_last_stats.uniform_uploads, m_last_stats.culled);
+    snprintf(lines[4], sizeof(lines[4]), "RES %dX%d  SUBMIT %.2f MS",
+             m_last_stats.target_width, m_last_stats.target_height, m_last_stats.submit_ms);
+    snprintf(lines[5], sizeof(lines[5]), "INPUT %.1f/%.1f MS (AVG/MAX OF %d)",
+             m_input_latency.average_ms, m_input_latency.max_ms, m_input_latency.events);
+
+    Renderer::get()->set_view_matrix(program, glm::mat4(1.0f));
+    for (int i = 0; i < 6; i++)
+        Utility::draw_text(program, font_texture_id, lines[i], FONT_SIZE, FONT_SPACING,
+                           TOP_LEFT - glm::vec3(0.0f, LINE_HEIGHT * i, 0.0f));
+    Renderer::get()->set_view_matrix(program, view_matrix);
+}
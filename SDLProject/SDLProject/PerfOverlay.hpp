@@ -0,0 +1,60 @@
+#ifndef PERFOVERLAY_H
+#define PERFOVERLAY_H
+
+#pragma once
+#define GL_SILENCE_DEPRECATION
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL.h>
+#include <SDL_opengl.h>
+#include "glm/mat4x4.hpp"
+#include "ShaderProgram.h"
+#include "Renderer.hpp"
+#include "InputQueue.hpp"
+
+// Rolling frame-time stats plus the renderer's counters for the last frame,
+// drawn in the top-left corner with the bitmap font. Toggled with F3.
+class PerfOverlay {
+public:
+    static constexpr int WINDOW = 240;  // frames kept for min/avg/p99
+
+    // A rolling window of samples
+    struct Series {
+        float samples[WINDOW];
+        int count = 0,
+            next  = 0;
+
+        void  add(float value);
+        float min() const;
+        float avg() const;
+        float percentile(float fraction) const;
+    };
+
+private:
+    bool m_visible = false;
+
+    Series m_frame_ms,  // full frame, including the vsync / cap wait
+           m_cpu_ms;    // just the work (RenderStats::cpu_frame_ms)
+    RenderStats m_last_stats;
+    InputLatency m_input_latency;
+
+public:
+    // Call once per frame, after present()
+    void add_frame(float frame_ms, const RenderStats &stats);
+    void set_input_latency(const InputLatency &latency) { m_input_latency = latency; }
+
+    void toggle()                       { m_visible = not m_visible; }
+    bool const is_visible() const       { return m_visible; }
+
+    const Series &get_frame_ms() const  { return m_frame_ms; }
+    const Series &get_cpu_ms()   const  { return m_cpu_ms; }
+
+    // Draws in screen space, then puts view_matrix back
+    void render(ShaderProgram *program, GLuint font_texture_id, const glm::mat4 &view_matrix) const;
+};
+
+#endif // PERFOVERLAY_H
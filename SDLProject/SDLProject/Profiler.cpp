@@ -0,0 +1,135 @@
+// Profiler.cpp
+#define LOG(argument) std::cout << argument << '\n'
+
+#include "Profiler.hpp"
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+
+namespace {
+    struct Event {
+        const char *name;
+        Uint64 start,
+               end;
+    };
+
+    // One per thread that has ever recorded a zone. The lock is only ever contended
+    // while end_session() is reading it out, so recording stays cheap
+    struct ThreadBuffer {
+        int id;
+        std::string name;
+        std::vector<Event> events;
+        int dropped = 0;
+        std::mutex mutex;
+    };
+
+    std::vector<std::unique_ptr<ThreadBuffer>> g_buffers;
+    std::mutex g_buffers_mutex;
+
+    std::atomic<bool> g_recording(false);
+    std::string g_filepath;
+    std::atomic<Uint64> g_session_start(0);
+
+    thread_local ThreadBuffer *t_buffer = nullptr;
+
+    ThreadBuffer *get_thread_buffer() {
+        if (t_buffer) return t_buffer;
+
+        // Never freed, so a thread can exit without leaving its events dangling
+        std::lock_guard<std::mutex> lock(g_buffers_mutex);
+        g_buffers.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer()));
+        t_buffer = g_buffers.back().get();
+        t_buffer->id = (int) g_buffers.size();
+        t_buffer->name = "Thread " + std::to_string(t_buffer->id);
+        return t_buffer;
+    }
+
+    double counter_to_us(Uint64 counter) {
+        return (double) counter * 1000000.0 / (double) SDL_GetPerformanceFrequency();
+    }
+
+    // Zone names are literals from our own code, but a quote would still break the file
+    std::string escape(const std::string &text) {
+        std::string escaped;
+        for (char character : text) {
+            if (character == '"' or character == '\\') escaped += '\\';
+            escaped += character;
+        }
+        return escaped;
+    }
+}
+
+void Profiler::begin_session(const std::string &filepath) {
+    std::lock_guard<std::mutex> lock(g_buffers_mutex);
+    for (auto &buffer : g_buffers) {
+        std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+        buffer->events.clear();
+        buffer->dropped = 0;
+    }
+    g_filepath = filepath;
+    g_session_start = SDL_GetPerformanceCounter();
+    g_recording = true;
+
+    LOG("Profiling to " << filepath);
+}
+
+void Profiler::end_session() {
+    if (not g_recording.exchange(false)) return;
+
+    std::ofstream out(g_filepath);
+    if (out.fail()) {
+        LOG("Unable to write profile to " << g_filepath);
+        return;
+    }
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    int event_count = 0,
+        dropped = 0;
+    bool first = true;
+    std::lock_guard<std::mutex> lock(g_buffers_mutex);
+    for (auto &buffer : g_buffers) {
+        std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+
+        out << (first ? "" : ",\n")
+            << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id
+            << ",\"args\":{\"name\":\"" << escape(buffer->name) << "\"}}";
+        first = false;
+
+        for (const Event &event : buffer->events) {
+            out << ",\n{\"name\":\"" << escape(event.name) << "\",\"cat\":\"cpu\",\"ph\":\"X\""
+                << ",\"ts\":" << counter_to_us(event.start - g_session_start.load())
+                << ",\"dur\":" << counter_to_us(event.end - event.start)
+                << ",\"pid\":1,\"tid\":" << buffer->id << "}";
+        }
+        event_count += (int) buffer->events.size();
+        dropped     += buffer->dropped;
+        buffer->events.clear();
+    }
+    out << "\n]}\n";
+
+    LOG("Wrote " << event_count << " zones to " << g_filepath);
+    if (dropped > 0) LOG("Dropped " << dropped << " zones over the per-thread limit.");
+}
+
+bool Profiler::is_recording() { return g_recording.load(std::memory_order_relaxed); }
+
+void Profiler::set_thread_name(const std::string &name) {
+    ThreadBuffer *buffer = get_thread_buffer();
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    buffer->name = name;
+}
+
+void Profiler::record(const char *name, Uint64 start, Uint64 end) {
+    // A zone that straddles begin_session() would come out with a negative timestamp
+    if (not is_recording() or start < g_session_start) return;
+
+    ThreadBuffer *buffer = get_thread_buffer();
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    if ((int) buffer->events.size() < MAX_EVENTS_PER_THREAD)
+        buffer->events.push_back({ name, start, end });
+    else buffer->dropped++;
+}
@@ -0,0 +1,60 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#pragma once
+#include <string>
+#include <SDL.h>
+
+// Scoped CPU zones, written out as a Chrome trace (chrome://tracing or
+// ui.perfetto.dev). Drop a PROFILE_SCOPE("name") or PROFILE_FUNCTION() at the
+// top of a block and it records how long that block took, on whichever thread
+// ran it. Nothing is recorded until begin_session(), so the zones can stay in
+// release builds; building with PROFILER_ENABLED=0 removes them entirely.
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+class Profiler {
+public:
+    // Stops a forgotten session from eating all the memory (~24 bytes per zone)
+    static constexpr int MAX_EVENTS_PER_THREAD = 1 << 20;
+
+    static void begin_session(const std::string &filepath);
+    // Writes everything recorded so far to the session's file
+    static void end_session();
+    static bool is_recording();
+
+    // Shows up as the track name in the trace viewer
+    static void set_thread_name(const std::string &name);
+
+    // Zone names must outlive the session, i.e. be string literals
+    static void record(const char *name, Uint64 start, Uint64 end);
+};
+
+class ProfileZone {
+private:
+    const char *m_name;
+    Uint64 m_start = 0;
+
+public:
+    ProfileZone(const char *name) : m_name(name) {
+        if (Profiler::is_recording()) m_start = SDL_GetPerformanceCounter();
+    }
+    ~ProfileZone() {
+        if (m_start != 0) Profiler::record(m_name, m_start, SDL_GetPerformanceCounter());
+    }
+};
+
+#if PROFILER_ENABLED
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileZone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__func__)
+#define PROFILE_THREAD(name) Profiler::set_thread_name(name)
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_THREAD(name)
+#endif
+
+#endif // PROFILER_H
@@ -0,0 +1,116 @@
+// RenderQueue.cpp
+#include "RenderQueue.hpp"
+#include "Profiler.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // layer | shader | texture | depth, from the top bit down
+    constexpr int   DEPTH_BITS      = 24,
+                    TEXTURE_BITS    = 24,
+                    PROGRAM_BITS    = 8,
+                    TEXTURE_SHIFT   = DEPTH_BITS,
+                    PROGRAM_SHIFT   = TEXTURE_SHIFT + TEXTURE_BITS,
+                    LAYER_SHIFT     = PROGRAM_SHIFT + PROGRAM_BITS;
+    constexpr int   RADIX_BITS      = 8,
+                    RADIX_BUCKETS   = 1 << RADIX_BITS,
+                    RADIX_PASSES    = 64 / RADIX_BITS;
+
+    Uint64 make_key(RenderLayer layer, int program, GLuint texture, float depth) {
+        // Depth is clamped to 0..1; lower draws first
+        Uint64 quantised_depth = (Uint64) (std::min(1.0f, std::max(0.0f, depth))
+                                           * ((1 << DEPTH_BITS) - 1));
+        return ((Uint64) layer << LAYER_SHIFT)
+             | ((Uint64) (program & ((1 << PROGRAM_BITS) - 1)) << PROGRAM_SHIFT)
+             | ((Uint64) (texture & ((1 << TEXTURE_BITS) - 1)) << TEXTURE_SHIFT)
+             | quantised_depth;
+    }
+}
+
+int RenderQueue::program_index(ShaderProgram *program) {
+    for (int i = 0; i < (int) m_programs.size(); i++)
+        if (m_programs[i] == program) return i;
+    m_programs.push_back(program);
+    return (int) m_programs.size() - 1;
+}
+
+void RenderQueue::submit(RenderLayer layer, float depth, ShaderProgram *program, GLuint texture,
+                         const glm::mat4 &model_matrix, const float *vertices,
+                         const float *tex_coords, int vertex_count) {
+    if (vertex_count <= 0) return;
+
+    Command command = { make_key(layer, program_index(program), texture, depth), program, texture,
+                        (int) m_vertices.size() / 2, vertex_count };
+    m_commands.push_back(command);
+
+    // Everything we draw is flat, so only the 2D part of the model matrix matters
+    m_vertices.reserve(m_vertices.size() + vertex_count * 2);
+    for (int i = 0; i < vertex_count; i++) {
+        float x = vertices[i * 2],
+              y = vertices[i * 2 + 1];
+        m_vertices.push_back(model_matrix[0][0] * x + model_matrix[1][0] * y + model_matrix[3][0]);
+        m_vertices.push_back(model_matrix[0][1] * x + model_matrix[1][1] * y + model_matrix[3][1]);
+    }
+    m_tex_coords.insert(m_tex_coords.end(), tex_coords, tex_coords + vertex_count * 2);
+}
+
+void RenderQueue::radix_sort() {
+    // LSD radix sort is stable, so draws with equal keys stay in submission order
+    m_sorted.resize(m_commands.size());
+    std::vector<Command> *source = &m_commands,
+                         *target = &m_sorted;
+
+    for (int pass = 0; pass < RADIX_PASSES; pass++) {
+        int shift = pass * RADIX_BITS;
+        int counts[RADIX_BUCKETS] = { 0 };
+        for (const Command &command : *source)
+            counts[(command.key >> shift) & (RADIX_BUCKETS - 1)]++;
+
+        // Most passes look at bits every key has in common; nothing to do for those
+        if (counts[(source->front().key >> shift) & (RADIX_BUCKETS - 1)] == (int) source->size())
+            continue;
+
+        int offsets[RADIX_BUCKETS];
+        int total = 0;
+        for (int bucket = 0; bucket < RADIX_BUCKETS; bucket++) {
+            offsets[bucket] = total;
+            total += counts[bucket];
+        }
+        for (const Command &command : *source)
+            (*target)[offsets[(command.key >> shift) & (RADIX_BUCKETS - 1)]++] = command;
+        std::swap(source, target);
+    }
+    if (source != &m_sorted) m_sorted = *source;
+}
+
+void RenderQueue::build_batches() {
+    PROFILE_SCOPE("RenderQueue::build_batches");
+    m_batches.clear();
+    m_batch_vertices.clear();
+    m_batch_tex_coords.clear();
+    if (m_commands.empty()) return;
+
+    radix_sort();
+
+    m_batch_vertices.reserve(m_vertices.size());
+    m_batch_tex_coords.reserve(m_tex_coords.size());
+    for (const Command &command : m_sorted) {
+        bool same_state = not m_batches.empty() and m_batches.back().program == command.program
+                          and m_batches.back().texture == command.texture;
+        if (same_state) m_batches.back().vertex_count += command.vertex_count;
+        else m_batches.push_back({ command.program, command.texture,
+                                   (int) m_batch_vertices.size() / 2, command.vertex_count });
+
+        const float *vertices   = &m_vertices[command.first_vertex * 2],
+                    *tex_coords = &m_tex_coords[command.first_vertex * 2];
+        m_batch_vertices.insert(m_batch_vertices.end(), vertices, vertices + command.vertex_count * 2);
+        m_batch_tex_coords.insert(m_batch_tex_coords.end(), tex_coords, tex_coords + command.vertex_count * 2);
+    }
+}
+
+void RenderQueue::clear() {
+    // Keeps the capacity, so a steady frame doesn't allocate
+    m_commands.clear();
+    m_vertices.clear();
+    m_tex_coords.clear();
+}
@@ -0,0 +1,73 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#pragma once
+#define GL_SILENCE_DEPRECATION
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <vector>
+#include <SDL.h>
+#include <SDL_opengl.h>
+#include "glm/mat4x4.hpp"
+#include "ShaderProgram.h"
+
+// Draw order, most significant part of the sort key
+enum RenderLayer { LAYER_BACKGROUND, LAYER_MAP, LAYER_ENTITIES, LAYER_HUD };
+
+// Collects the frame's draws instead of issuing them straight away, then sorts
+// them by (layer, shader, texture, depth) and merges neighbours that share a
+// shader and texture into one batch. Vertices are moved into world space as
+// they're submitted, so a batch can mix sprites with different model matrices.
+class RenderQueue {
+public:
+    struct Batch {
+        ShaderProgram *program;
+        GLuint texture;         // backend texture, not a Renderer texture id
+        int first_vertex,
+            vertex_count;
+    };
+
+private:
+    struct Command {
+        Uint64 key;
+        ShaderProgram *program;
+        GLuint texture;
+        int first_vertex,
+            vertex_count;
+    };
+
+    std::vector<Command> m_commands,
+                         m_sorted;
+    std::vector<float>   m_vertices,        // world space, in submission order
+                         m_tex_coords;
+    std::vector<ShaderProgram*> m_programs; // so each one gets a small number for the key
+
+    std::vector<Batch>   m_batches;
+    std::vector<float>   m_batch_vertices,  // the same, in sorted order
+                         m_batch_tex_coords;
+
+    int program_index(ShaderProgram *program);
+    void radix_sort();
+
+public:
+    void submit(RenderLayer layer, float depth, ShaderProgram *program, GLuint texture,
+                const glm::mat4 &model_matrix, const float *vertices, const float *tex_coords,
+                int vertex_count);
+
+    // Sorts what's been submitted and fills in the batches and their vertex arrays
+    void build_batches();
+    void clear();
+
+    bool const is_empty() const { return m_commands.empty(); }
+    int  const get_command_count() const { return (int) m_commands.size(); }
+
+    const std::vector<Batch> &get_batches()         const { return m_batches; }
+    const float *get_batch_vertices()               const { return m_batch_vertices.data(); }
+    const float *get_batch_tex_coords()             const { return m_batch_tex_coords.data(); }
+};
+
+#endif // RENDERQUEUE_H
@@ -0,0 +1,116 @@
+// Renderer.cpp
+#define LOG(argument) std::cout << argument << '\n'
+
+#include "Renderer.hpp"
+#include "Profiler.hpp"
+#include "glm/matrix.hpp"
+#include <algorithm>
+#include <iostream>
+
+Renderer *Renderer::s_active = nullptr;
+
+void Renderer::begin_frame() {
+    m_stats = RenderStats();
+    m_frame_start = SDL_GetPerformanceCounter();
+}
+
+void Renderer::draw_triangles(ShaderProgram *program, GLuint texture_id, const glm::mat4 &model_matrix,
+                              const float *vertices, const float *tex_coords, int vertex_count,
+                              RenderLayer layer, float depth) {
+    m_queue.submit(layer, depth, program, get_region(texture_id).texture, model_matrix,
+                   vertices, tex_coords, vertex_count);
+    m_stats.commands++;
+}
+
+void Renderer::flush() {
+    if (m_queue.is_empty()) return;
+    PROFILE_SCOPE("Renderer::flush");
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    m_queue.build_batches();
+    submit_batches(m_queue);
+    m_queue.clear();
+
+    m_stats.submit_ms += (float) (SDL_GetPerformanceCounter() - start) * 1000.0f
+                         / (float) SDL_GetPerformanceFrequency();
+}
+
+void Renderer::set_projection_matrix(ShaderProgram *program, const glm::mat4 &projection_matrix) {
+    // Whatever's queued was meant for the old matrices
+    flush();
+    m_projection_matrix = projection_matrix;
+    update_visible_bounds();
+    apply_projection_matrix(program, projection_matrix);
+}
+
+void Renderer::set_view_matrix(ShaderProgram *program, const glm::mat4 &view_matrix) {
+    flush();
+    m_view_matrix = view_matrix;
+    update_visible_bounds();
+    apply_view_matrix(program, view_matrix);
+}
+
+void Renderer::update_visible_bounds() {
+    // Take the corners of clip space back into the world
+    glm::mat4 clip_to_world = glm::inverse(m_projection_matrix * m_view_matrix);
+    glm::vec4 corner_a = clip_to_world * glm::vec4(-1.0f, -1.0f, 0.0f, 1.0f),
+              corner_b = clip_to_world * glm::vec4( 1.0f,  1.0f, 0.0f, 1.0f);
+
+    m_visible_bounds = { std::min(corner_a.x, corner_b.x), std::max(corner_a.x, corner_b.x),
+                         std::min(corner_a.y, corner_b.y), std::max(corner_a.y, corner_b.y) };
+}
+
+bool Renderer::is_visible(const Bounds &bounds) {
+    if (bounds.overlaps(m_visible_bounds)) return true;
+    m_stats.culled++;
+    return false;
+}
+
+GLuint Renderer::add_region(const TextureRegion &region, bool owns_texture) {
+    std::lock_guard<std::mutex> lock(m_region_mutex);
+    m_regions.push_back(region);
+    m_owns_texture.push_back(owns_texture);
+    return (GLuint) m_regions.size();
+}
+
+GLuint Renderer::remove_region(GLuint texture_id) {
+    std::lock_guard<std::mutex> lock(m_region_mutex);
+    if (texture_id == 0 or texture_id > m_regions.size()) return 0;
+
+    // Ids aren't reused, the slot just stops pointing anywhere
+    GLuint texture = m_owns_texture[texture_id - 1] ? m_regions[texture_id - 1].texture : 0;
+    m_regions[texture_id - 1] = TextureRegion();
+    m_owns_texture[texture_id - 1] = false;
+    return texture;
+}
+
+GLuint Renderer::create_region(GLuint page_id, int x, int y, int width, int height, int page_size) {
+    TextureRegion region;
+    region.texture = get_region(page_id).texture;
+    region.u       = (float) x      / page_size;
+    region.v       = (float) y      / page_size;
+    region.width   = (float) width  / page_size;
+    region.height  = (float) height / page_size;
+    return add_region(region, false);
+}
+
+TextureRegion Renderer::get_region(GLuint texture_id) const {
+    std::lock_guard<std::mutex> lock(m_region_mutex);
+    if (texture_id == 0 or texture_id > m_regions.size()) {
+        TextureRegion whole;
+        whole.texture = texture_id;
+        return whole;
+    }
+    return m_regions[texture_id - 1];
+}
+
+void Renderer::finish_frame_stats() {
+    Uint64 now = SDL_GetPerformanceCounter();
+    m_stats.cpu_frame_ms = (float) (now - m_frame_start) * 1000.0f
+                           / (float) SDL_GetPerformanceFrequency();
+    m_last_stats = m_stats;
+
+    // In case nobody calls begin_frame() (e.g. the loading screen)
+    m_stats = RenderStats();
+    m_frame_start = now;
+}
@@ -0,0 +1,230 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#pragma once
+#define GL_SILENCE_DEPRECATION
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL.h>
+#include <SDL_opengl.h>
+#include <vector>
+#include <mutex>
+#include "glm/mat4x4.hpp"
+#include "ShaderProgram.h"
+#include "SpatialGrid.hpp"
+#include "RenderQueue.hpp"
+
+// FULL draws straight to the window. PIXEL_PERFECT draws at the art's native
+// resolution and scales it up by a whole number, letterboxed. DYNAMIC draws
+// somewhere between the two, dropping towards native when frames run late.
+enum ResolutionMode { FULL_RESOLUTION, PIXEL_PERFECT, DYNAMIC_RESOLUTION };
+
+// Where a texture id's image lives: a backend texture and the part of it in UV
+// space. Whole textures cover 0..1; images packed into an atlas page cover a
+// sub-rectangle, so anything building UVs should pass them through map_u/map_v
+struct TextureRegion {
+    GLuint texture = 0;
+    float u      = 0.0f,
+          v      = 0.0f,
+          width  = 1.0f,
+          height = 1.0f;
+
+    float const map_u(float s) const { return u + s * width;  }
+    float const map_v(float t) const { return v + t * height; }
+};
+
+// What one frame cost, counted by the backend as it issues the work
+struct RenderStats {
+    int commands            = 0,        // draw_triangles calls
+        draw_calls          = 0,        // what they turned into after sorting and batching
+        vertices            = 0,
+        texture_binds       = 0,
+        program_switches    = 0,
+        uniform_uploads     = 0,
+        culled              = 0;    // sprites and text skipped by is_visible()
+    float cpu_frame_ms      = 0.0f,     // begin_frame() up to the swap, i.e. without the vsync wait
+          submit_ms         = 0.0f;     // sorting, batching and handing the batches to the backend
+    int target_width        = 0,        // what the scene was drawn at
+        target_height       = 0;
+};
+
+// Everything that draws (Map, Entity, Utility::draw_text) goes through the active
+// Renderer instead of calling GL itself, so the game can run with no window and
+// no GL context by swapping in the NullRenderer.
+class Renderer {
+public:
+    virtual ~Renderer() {}
+
+    // Texture ids are the renderer's own, not GL names: each one is a region, so
+    // an atlas page and the images packed into it can all be drawn by id
+    virtual GLuint upload_texture(const unsigned char *pixels, int width, int height) = 0;
+    virtual void delete_texture(GLuint texture_id) = 0;
+
+    // A new id for the given pixel rectangle of a square page uploaded earlier
+    GLuint create_region(GLuint page_id, int x, int y, int width, int height, int page_size);
+    // Safe from any thread (Map::build runs on the loader's workers); unknown ids
+    // come back as a whole texture
+    TextureRegion get_region(GLuint texture_id) const;
+
+    // Queues vertex_count vertices as triangles; vertices and tex_coords are 2 floats
+    // each. Nothing reaches the backend until the queue is flushed, in sorted order
+    void draw_triangles(ShaderProgram *program, GLuint texture_id, const glm::mat4 &model_matrix,
+                        const float *vertices, const float *tex_coords, int vertex_count,
+                        RenderLayer layer = LAYER_ENTITIES, float depth = 0.0f);
+    // Sorts, batches and submits everything queued so far. present() and
+    // begin_overlay() do this, as does changing the view or projection
+    void flush();
+
+    // These go through the renderer rather than the ShaderProgram so they get
+    // counted, and so it knows which part of the world is on screen
+    void set_projection_matrix(ShaderProgram *program, const glm::mat4 &projection_matrix);
+    void set_view_matrix(ShaderProgram *program, const glm::mat4 &view_matrix);
+
+    // The world rectangle the current view and projection show
+    const Bounds &get_visible_bounds() const { return m_visible_bounds; }
+    // False (and counted as culled) if bounds are entirely off screen
+    bool is_visible(const Bounds &bounds);
+
+    virtual void clear() = 0;
+    // Anything drawn after this goes straight to the window at full resolution
+    // (the perf overlay), rather than into the low-res target
+    virtual void begin_overlay() = 0;
+    virtual void present() = 0;
+
+    virtual void set_resolution_mode(ResolutionMode mode, int native_width, int native_height,
+                                     float frame_budget_ms) { }
+
+    virtual bool const is_headless() const = 0;
+
+    /* ----- STATS ----- */
+    // Call at the top of each frame so cpu_frame_ms covers input and update too
+    void begin_frame();
+    // Counters for the last presented frame
+    const RenderStats &get_stats() const { return m_last_stats; }
+
+    static Renderer *get() { return s_active; }
+    static void set(Renderer *renderer) { s_active = renderer; }
+
+protected:
+    RenderStats m_stats,
+                m_last_stats;
+    Uint64 m_frame_start = 0;
+
+    glm::mat4 m_projection_matrix = glm::mat4(1.0f),
+              m_view_matrix       = glm::mat4(1.0f);
+    // Until a camera is set up, everything counts as visible
+    Bounds m_visible_bounds = { -1.0e9f, 1.0e9f, -1.0e9f, 1.0e9f };
+
+    void update_visible_bounds();
+
+    GLuint add_region(const TextureRegion &region, bool owns_texture);
+    // Returns the backend texture to free, or 0 if the region was part of a page
+    GLuint remove_region(GLuint texture_id);
+
+    RenderQueue m_queue;
+
+    virtual void apply_projection_matrix(ShaderProgram *program, const glm::mat4 &projection_matrix) = 0;
+    virtual void apply_view_matrix(ShaderProgram *program, const glm::mat4 &view_matrix) = 0;
+    // Vertices come already in world space, so the model matrix should be identity
+    virtual void submit_batches(const RenderQueue &queue) = 0;
+
+    // Backends call this in present(), before they block on the swap
+    void finish_frame_stats();
+
+private:
+    static Renderer *s_active;
+
+    // Indexed by texture id - 1, so 0 stays "no texture"
+    std::vector<TextureRegion> m_regions;
+    std::vector<bool>          m_owns_texture;
+    mutable std::mutex         m_region_mutex;
+};
+
+class GLRenderer : public Renderer {
+private:
+    static constexpr float  DYNAMIC_STEP            = 0.125f,   // of the way from native to full
+                            DYNAMIC_LATE_FACTOR     = 1.2f;     // a frame this far over budget is late
+    static constexpr int    DYNAMIC_LATE_FRAMES     = 3,        // in a row before we drop a step
+                            DYNAMIC_RECOVER_FRAMES  = 120;      // on time in a row before we try one up
+
+    SDL_Window *m_window;
+
+    /* ----- LOW-RES TARGET ----- */
+    ResolutionMode m_resolution_mode = FULL_RESOLUTION;
+    int     m_native_width  = 0,
+            m_native_height = 0,
+            m_window_width  = 0,
+            m_window_height = 0,
+            m_target_width  = 0,
+            m_target_height = 0;
+    GLuint  m_framebuffer     = 0,
+            m_target_texture  = 0;
+    bool    m_resolved        = true;   // nothing left in the target that isn't on screen
+
+    // So draws from the same atlas page don't rebind it
+    GLuint  m_bound_texture   = 0;
+
+    // 1 = full window, 0 = native; only moves in DYNAMIC_RESOLUTION
+    float   m_dynamic_level   = 1.0f;
+    float   m_frame_budget_ms = 1000.0f / 60.0f;
+    Uint64  m_last_present    = 0;
+    int     m_late_frames     = 0,
+            m_on_time_frames  = 0;
+
+    void resize_target(int width, int height);
+    void resolve_target();
+    void update_dynamic_level();
+
+protected:
+    void apply_projection_matrix(ShaderProgram *program, const glm::mat4 &projection_matrix) override;
+    void apply_view_matrix(ShaderProgram *program, const glm::mat4 &view_matrix) override;
+    void submit_batches(const RenderQueue &queue) override;
+
+public:
+    GLRenderer(SDL_Window *window) : m_window(window) {}
+    ~GLRenderer();
+
+    GLuint upload_texture(const unsigned char *pixels, int width, int height) override;
+    void delete_texture(GLuint texture_id) override;
+    void clear() override;
+    void begin_overlay() override;
+    void present() override;
+    void set_resolution_mode(ResolutionMode mode, int native_width, int native_height,
+                             float frame_budget_ms) override;
+    bool const is_headless() const override { return false; }
+};
+
+// Hands out fake texture ids and drops every draw on the floor, though it still
+// counts them so headless runs can check what would have been drawn
+class NullRenderer : public Renderer {
+private:
+    GLuint m_next_fake_texture = 1;
+
+protected:
+    void apply_projection_matrix(ShaderProgram *program, const glm::mat4 &projection_matrix) override { }
+    void apply_view_matrix(ShaderProgram *program, const glm::mat4 &view_matrix) override { }
+    void submit_batches(const RenderQueue &queue) override {
+        for (const RenderQueue::Batch &batch : queue.get_batches()) {
+            m_stats.draw_calls++;
+            m_stats.vertices += batch.vertex_count;
+        }
+    }
+
+public:
+    GLuint upload_texture(const unsigned char *pixels, int width, int height) override {
+        TextureRegion region;
+        region.texture = m_next_fake_texture++;
+        return add_region(region, true);
+    }
+    void delete_texture(GLuint texture_id) override { remove_region(texture_id); }
+    void clear() override { }
+    void begin_overlay() override { flush(); }
+    void present() override { flush(); finish_frame_stats(); }
+    bool const is_headless() const override { return true; }
+};
+
+#endif // RENDERER_H
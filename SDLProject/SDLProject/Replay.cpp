@@ -0,0 +1,141 @@
+// Replay.cpp
+#define LOG(argument) std::cout << argument << '\n'
+
+#include "Replay.hpp"
+#include <cstring>
+#include <iostream>
+
+namespace {
+    const char   REPLAY_MAGIC[4] = { 'R', 'P', 'L', 'Y' };
+    const Uint32 REPLAY_VERSION  = 1;
+
+    enum TickBits { TICK_LEFT = 1, TICK_RIGHT = 2, TICK_JUMP = 4, TICK_START = 8, TICK_PAUSED = 16,
+                    TICK_REWIND = 32 };
+
+    Uint8 pack(const ReplayTick &tick) {
+        return (tick.input.left  ? TICK_LEFT   : 0) | (tick.input.right ? TICK_RIGHT  : 0)
+             | (tick.input.jump  ? TICK_JUMP   : 0) | (tick.input.start ? TICK_START  : 0)
+             | (tick.paused      ? TICK_PAUSED : 0) | (tick.input.rewind ? TICK_REWIND : 0);
+    }
+
+    ReplayTick unpack(Uint8 bits) {
+        ReplayTick tick;
+        tick.input.left  = bits & TICK_LEFT;
+        tick.input.right = bits & TICK_RIGHT;
+        tick.input.jump  = bits & TICK_JUMP;
+        tick.input.start = bits & TICK_START;
+        tick.paused      = bits & TICK_PAUSED;
+        tick.input.rewind = bits & TICK_REWIND;
+        return tick;
+    }
+}
+
+Uint64 Replay::hash(Uint64 hash, const void *data, size_t length) {
+    const unsigned char *bytes = (const unsigned char *) data;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/* ----- RECORDING ----- */
+
+bool ReplayRecorder::begin(const std::string &path, int sim_hz, int first_scene, Uint32 seed) {
+    m_file.open(path, std::ios::binary | std::ios::trunc);
+    if (not m_file) {
+        LOG("Unable to record to " << path << ".");
+        return false;
+    }
+
+    memcpy(m_header.magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+    m_header.version     = REPLAY_VERSION;
+    m_header.sim_hz      = sim_hz;
+    m_header.first_scene = first_scene;
+    m_header.seed        = seed;
+    m_header.tick_count  = 0;
+    m_header.final_hash  = 0;
+
+    // Written again with the real counts by end()
+    m_file.write((const char *) &m_header, sizeof(m_header));
+    m_run_length = 0;
+    return true;
+}
+
+void ReplayRecorder::record(const ReplayTick &tick) {
+    if (not is_recording()) return;
+
+    Uint8 value = pack(tick);
+    if (m_run_length > 0 and value != m_run_value) flush_run();
+    m_run_value = value;
+    m_run_length++;
+    m_header.tick_count++;
+}
+
+void ReplayRecorder::flush_run() {
+    // The value, then the run length as a little-endian base-128 varint
+    m_file.put((char) m_run_value);
+    Uint32 length = m_run_length;
+    do {
+        Uint8 byte = length & 0x7f;
+        length >>= 7;
+        m_file.put((char) (length > 0 ? byte | 0x80 : byte));
+    } while (length > 0);
+    m_run_length = 0;
+}
+
+void ReplayRecorder::end(Uint64 final_hash) {
+    if (not is_recording()) return;
+    if (m_run_length > 0) flush_run();
+
+    m_header.final_hash = final_hash;
+    m_file.seekp(0);
+    m_file.write((const char *) &m_header, sizeof(m_header));
+    m_file.close();
+
+    LOG("Recorded " << m_header.tick_count << " ticks, final state " << std::hex << final_hash
+        << std::dec << ".");
+}
+
+/* ----- PLAYBACK ----- */
+
+bool ReplayPlayer::load(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (not file.read((char *) &m_header, sizeof(m_header))
+        or memcmp(m_header.magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC)) != 0
+        or m_header.version != REPLAY_VERSION) {
+        LOG("Unable to read replay " << path << ".");
+        return false;
+    }
+
+    m_runs.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    m_offset = 0;
+    m_run_left = 0;
+    m_ticks_played = 0;
+    return true;
+}
+
+bool ReplayPlayer::next(ReplayTick &tick) {
+    if (m_ticks_played >= m_header.tick_count) return false;
+
+    if (m_run_left == 0) {
+        if (m_offset >= m_runs.size()) return false;
+        m_run_value = m_runs[m_offset++];
+
+        Uint32 length = 0;
+        int shift = 0;
+        while (m_offset < m_runs.size()) {
+            Uint8 byte = m_runs[m_offset++];
+            length |= (Uint32) (byte & 0x7f) << shift;
+            shift += 7;
+            if (not (byte & 0x80)) break;
+        }
+        if (length == 0) return false;
+        m_run_left = length;
+    }
+
+    tick = unpack(m_run_value);
+    m_run_left--;
+    m_ticks_played++;
+    return true;
+}
@@ -0,0 +1,77 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#pragma once
+#include <SDL.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include "InputQueue.hpp"
+
+// One fixed step's worth of everything from outside the simulation
+struct ReplayTick {
+    StepInput input;
+    bool paused = false;
+};
+
+// What a run starts from, and what it should end on
+struct ReplayHeader {
+    char    magic[4];
+    Uint32  version,
+            sim_hz,
+            first_scene,
+            seed,
+            tick_count;
+    Uint64  final_hash;
+};
+
+// Writes the input every fixed step consumed, so the same run can be played back
+// bit for bit. Ticks are packed into a byte each and run-length encoded, since
+// input rarely changes from one step to the next: a minute of play is usually a
+// few hundred bytes.
+class ReplayRecorder {
+private:
+    std::ofstream m_file;
+    ReplayHeader m_header;
+
+    Uint8  m_run_value = 0;
+    Uint32 m_run_length = 0;
+
+    void flush_run();
+
+public:
+    bool begin(const std::string &path, int sim_hz, int first_scene, Uint32 seed);
+    void record(const ReplayTick &tick);
+    // Fills in the tick count and the hash of the final state, and closes the file
+    void end(Uint64 final_hash);
+
+    bool const is_recording() const { return m_file.is_open(); }
+};
+
+// Reads a recording back one tick at a time
+class ReplayPlayer {
+private:
+    ReplayHeader m_header;
+    std::vector<Uint8> m_runs;
+    size_t m_offset = 0;
+
+    Uint8  m_run_value = 0;
+    Uint32 m_run_left = 0,
+           m_ticks_played = 0;
+
+public:
+    bool load(const std::string &path);
+    // False once every recorded tick has been played
+    bool next(ReplayTick &tick);
+
+    const ReplayHeader &get_header() const { return m_header; }
+    Uint32 const get_ticks_played() const { return m_ticks_played; }
+};
+
+namespace Replay {
+    // FNV-1a, continuing from hash; start from HASH_SEED
+    constexpr Uint64 HASH_SEED = 14695981039346656037ull;
+    Uint64 hash(Uint64 hash, const void *data, size_t length);
+}
+
+#endif // REPLAY_H
@@ -0,0 +1,180 @@
+// Rollback.cpp
+#define LOG(argument) std::cout << argument << '\n'
+
+#include "Rollback.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+constexpr float MILLISECONDS_IN_SECOND = 1000.0f;
+
+namespace {
+    const Uint32 PACKET_MAGIC = 0x314b4252;    // "RBK1"
+
+    struct PacketHeader {
+        Uint32 magic;
+        Sint32 first_frame,         // of the inputs that follow, one byte each
+               acked;               // the sender has our input up to here
+        Uint32 count;
+    };
+
+    enum InputBits { INPUT_LEFT = 1, INPUT_RIGHT = 2, INPUT_JUMP = 4 };
+
+    // Start and rewind don't mean anything in a two-player game
+    Uint8 pack(const StepInput &input) {
+        return (input.left ? INPUT_LEFT : 0) | (input.right ? INPUT_RIGHT : 0)
+             | (input.jump ? INPUT_JUMP : 0);
+    }
+
+    StepInput unpack(Uint8 bits) {
+        StepInput input;
+        input.left  = bits & INPUT_LEFT;
+        input.right = bits & INPUT_RIGHT;
+        input.jump  = bits & INPUT_JUMP;
+        return input;
+    }
+
+    bool same_input(const StepInput &a, const StepInput &b) { return pack(a) == pack(b); }
+}
+
+RollbackSession::RollbackSession(Transport *transport, int local_player) :
+m_transport(transport), m_local_player(local_player) { }
+
+void RollbackSession::set_callbacks(SaveFunction save, LoadFunction load, StepFunction step) {
+    m_save = save;
+    m_load = load;
+    m_step = step;
+}
+
+void RollbackSession::restart(int frame) {
+    m_frame = frame;
+    m_base_frame = frame;
+    m_rollback_to = -1;
+}
+
+int const RollbackSession::get_confirmed_frame() const {
+    return std::min(m_frame, m_remote_through + 1);
+}
+
+const std::vector<Uint8> *RollbackSession::get_saved_state(int frame) const {
+    if (frame < m_base_frame or frame >= m_frame or frame < m_frame - HISTORY_SIZE) return nullptr;
+    return &m_frames[frame % HISTORY_SIZE].state;
+}
+
+void RollbackSession::poll() {
+    receive_packets();
+    if (m_rollback_to >= 0) resimulate();
+    send_inputs();
+}
+
+bool RollbackSession::advance(const StepInput &local_input) {
+    receive_packets();
+    if (m_rollback_to >= 0) resimulate();
+
+    // Too far ahead of the peer to keep guessing, or so far ahead of what they've
+    // acknowledged that the inputs we'd need to resend are about to be overwritten
+    if (m_frame - m_remote_through > MAX_ROLLBACK
+        or m_frame - m_remote_acked >= HISTORY_SIZE - 1) {
+        m_stats.stalls++;
+        send_inputs();
+        return false;
+    }
+
+    // Through the packet format, so both sides step with exactly the same input
+    m_frames[m_frame % HISTORY_SIZE].inputs[m_local_player] = unpack(pack(local_input));
+    run_frame(m_frame);
+    m_frame++;
+    m_stats.frames++;
+
+    send_inputs();
+    return true;
+}
+
+void RollbackSession::run_frame(int frame) {
+    Frame &record = m_frames[frame % HISTORY_SIZE];
+    int remote = 1 - m_local_player;
+
+    if (frame <= m_remote_through) record.inputs[remote] = m_remote_inputs[frame % HISTORY_SIZE];
+    else {
+        // Guess they're still holding whatever they were; a jump is a single press,
+        // so that isn't repeated
+        StepInput guess;
+        if (m_remote_through >= 0) guess = m_remote_inputs[m_remote_through % HISTORY_SIZE];
+        guess.jump = false;
+        record.inputs[remote] = guess;
+    }
+
+    m_save(record.state);
+    m_step(record.inputs);
+}
+
+void RollbackSession::resimulate() {
+    int from = m_rollback_to;
+    m_rollback_to = -1;
+    if (from < m_base_frame or from < m_frame - HISTORY_SIZE) {
+        LOG("Rollback to frame " << from << " is out of reach; the peers may have diverged.");
+        return;
+    }
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    m_resimulating = true;
+    m_load(m_frames[from % HISTORY_SIZE].state);
+    for (int frame = from; frame < m_frame; frame++) run_frame(frame);
+    m_resimulating = false;
+
+    float elapsed_ms = (float) (SDL_GetPerformanceCounter() - start) * MILLISECONDS_IN_SECOND
+                       / (float) SDL_GetPerformanceFrequency();
+    m_stats.rollbacks++;
+    m_stats.resimulated += m_frame - from;
+    m_stats.deepest = std::max(m_stats.deepest, m_frame - from);
+    m_stats.peak_resimulate_ms = std::max(m_stats.peak_resimulate_ms, elapsed_ms);
+}
+
+void RollbackSession::receive_packets() {
+    Uint8 buffer[Transport::MAX_PACKET_SIZE];
+    int remote = 1 - m_local_player;
+
+    int length;
+    while ((length = m_transport->receive(buffer)) > 0) {
+        PacketHeader header;
+        if (length < (int) sizeof(header)) continue;
+        memcpy(&header, buffer, sizeof(header));
+        if (header.magic != PACKET_MAGIC or length < (int) (sizeof(header) + header.count)) continue;
+
+        m_remote_acked = std::max(m_remote_acked, header.acked);
+
+        const Uint8 *inputs = buffer + sizeof(header);
+        for (int i = 0; i < (int) header.count; i++) {
+            int frame = header.first_frame + i;
+            if (frame <= m_remote_through) continue;
+            // Only in order: anything after a gap waits for a packet that fills it
+            if (frame != m_remote_through + 1) break;
+            // Can't happen while they respect MAX_ROLLBACK, but it would overwrite history
+            if (frame >= m_frame + HISTORY_SIZE - MAX_ROLLBACK - 1) break;
+
+            StepInput input = unpack(inputs[i]);
+            m_remote_inputs[frame % HISTORY_SIZE] = input;
+            m_remote_through = frame;
+
+            // Already run on a guess: if it was wrong, that step and everything after it goes again
+            if (frame < m_frame and not same_input(input, m_frames[frame % HISTORY_SIZE].inputs[remote]))
+                m_rollback_to = m_rollback_to < 0 ? frame : std::min(m_rollback_to, frame);
+        }
+    }
+}
+
+void RollbackSession::send_inputs() {
+    Uint8 buffer[sizeof(PacketHeader) + MAX_REDUNDANT];
+
+    // Oldest first, so a long run of losses can't leave a hole nobody resends
+    PacketHeader header;
+    header.magic        = PACKET_MAGIC;
+    header.first_frame  = m_remote_acked + 1;
+    header.acked        = m_remote_through;
+    header.count        = (Uint32) std::max(0, std::min(m_frame - header.first_frame, (int) MAX_REDUNDANT));
+
+    memcpy(buffer, &header, sizeof(header));
+    for (int i = 0; i < (int) header.count; i++)
+        buffer[sizeof(header) + i] = pack(m_frames[(header.first_frame + i) % HISTORY_SIZE].inputs[m_local_player]);
+    m_transport->send(buffer, (int) (sizeof(header) + header.count));
+}
@@ -0,0 +1,104 @@
+#ifndef ROLLBACK_H
+#define ROLLBACK_H
+
+#pragma once
+#include <SDL.h>
+#include <functional>
+#include <vector>
+#include "InputQueue.hpp"
+#include "Network.hpp"
+
+struct RollbackStats {
+    int     frames          = 0,
+            rollbacks       = 0,
+            resimulated     = 0,    // steps run again because of a misprediction
+            deepest         = 0,    // most steps rolled back at once
+            stalls          = 0;    // ticks spent waiting for the peer to catch up
+    float   peak_resimulate_ms = 0.0f;
+};
+
+// Peer-to-peer rollback for two players. Every tick the local input is sent to
+// the peer straight away and the step runs with a guess for the peer's input
+// (whatever they were last known to be doing). The state at the start of each
+// step is saved, so when the peer's real input turns up and doesn't match the
+// guess, the session goes back to that step and runs forward again to where it
+// was, all within the tick.
+//
+// Packets repeat every input the peer hasn't acknowledged yet, so a lost packet
+// just means the next one fills the gap. If the peer falls more than
+// MAX_ROLLBACK steps behind, this side waits for it rather than guessing further.
+//
+// The game plugs in through three callbacks: save and load the state as a blob,
+// and run one step with both players' input.
+class RollbackSession {
+public:
+    static constexpr int    MAX_ROLLBACK = 8,
+                            PLAYER_COUNT = 2;
+
+    typedef std::function<void(std::vector<Uint8> &state)>          SaveFunction;
+    typedef std::function<void(const std::vector<Uint8> &state)>    LoadFunction;
+    typedef std::function<void(const StepInput inputs[PLAYER_COUNT])> StepFunction;
+
+private:
+    static constexpr int    HISTORY_SIZE    = 32,   // steps; must be well over MAX_ROLLBACK
+                            MAX_REDUNDANT   = 16;   // unacknowledged inputs repeated per packet
+
+    struct Frame {
+        StepInput inputs[PLAYER_COUNT];     // what the step ran with, guesses included
+        std::vector<Uint8> state;           // at the start of the step; reused
+    };
+
+    Transport *m_transport;                 // not owned
+    int m_local_player;
+
+    SaveFunction m_save;
+    LoadFunction m_load;
+    StepFunction m_step;
+
+    Frame m_frames[HISTORY_SIZE];
+    StepInput m_remote_inputs[HISTORY_SIZE];    // by frame, as they arrive
+
+    int m_frame         = 0,        // the next step to run
+        m_base_frame    = 0,        // no state from before this (a scene switch) can be loaded
+        m_remote_through = -1,      // the peer's input is known for every step up to this
+        m_remote_acked  = -1,       // and they have ours up to this
+        m_rollback_to   = -1;       // earliest step that ran on a wrong guess, or -1
+    bool m_resimulating = false;
+
+    RollbackStats m_stats;
+
+    void receive_packets();
+    void send_inputs();
+    void resimulate();
+    void run_frame(int frame);
+
+public:
+    RollbackSession(Transport *transport, int local_player);
+
+    void set_callbacks(SaveFunction save, LoadFunction load, StepFunction step);
+
+    // Runs the next step with this input, after rolling back and fixing up anything
+    // the peer's latest packets contradict. False if it had to wait for the peer
+    // instead, in which case nothing ran and the input should be offered again
+    bool advance(const StepInput &local_input);
+    // Just the network half of advance(): take in packets, fix up, send ours again
+    void poll();
+
+    // For a new scene: forgets the saved states and starts counting from frame
+    void restart(int frame);
+
+    // Every step before this has run with both players' real input, so the state
+    // at its start is the same on both sides
+    int const get_confirmed_frame() const;
+    int const get_frame() const { return m_frame; }
+    // The state at the start of frame, if it's still held (confirmed or not)
+    const std::vector<Uint8> *get_saved_state(int frame) const;
+
+    // True while a rolled-back step is being run again; the game shouldn't play
+    // sounds or anything else that can't be taken back
+    bool const is_resimulating() const { return m_resimulating; }
+    int const get_local_player() const { return m_local_player; }
+    RollbackStats const get_stats() const { return m_stats; }
+};
+
+#endif // ROLLBACK_H
@@ -0,0 +1,47 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#pragma once
+#include <atomic>
+
+// A fixed-size ring for one producer thread and one consumer thread, with no
+// locks and no allocation, so the audio callback can read it without ever
+// blocking on the game. Capacity must be a power of two; one slot is kept
+// empty to tell full from empty.
+template <typename T, int CAPACITY>
+class SPSCQueue {
+private:
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "SPSCQueue capacity must be a power of two");
+    static constexpr int MASK = CAPACITY - 1;
+
+    T m_items[CAPACITY];
+
+    // Padded apart, so the two threads don't keep stealing each other's cache line
+    std::atomic<int> m_head { 0 };      // next to read, written by the consumer
+    char m_padding[64];
+    std::atomic<int> m_tail { 0 };      // next to write, written by the producer
+
+public:
+    // Producer: false (and nothing queued) if the consumer has fallen that far behind
+    bool push(const T &item) {
+        int tail = m_tail.load(std::memory_order_relaxed),
+            next = (tail + 1) & MASK;
+        if (next == m_head.load(std::memory_order_acquire)) return false;
+
+        m_items[tail] = item;
+        m_tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer
+    bool pop(T &item) {
+        int head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) return false;
+
+        item = m_items[head];
+        m_head.store((head + 1) & MASK, std::memory_order_release);
+        return true;
+    }
+};
+
+#endif // SPSCQUEUE_H
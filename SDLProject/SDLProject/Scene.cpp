@@ -1,8 +1,224 @@
 // Scene.c++
 #include "Scene.hpp"
+#include "Renderer.hpp"
+#include "Replay.hpp"
+#include <cstring>
 
-Scene::Scene() {
-    g_map_texture_id = Utility::load_texture(MAP_TILESET_FILEPATH);
-    g_font_texture_id = Utility::load_texture(FONTSHEET_FILEPATH);
-    g_sprite_texture_id = Utility::load_texture(SPRITESHEET_FILEPATH);
+struct SceneStateHeader {
+    Sint32 lives;
+    Uint32 entity_count;
+};
+
+constexpr float GRID_CELL_SIZE  = 4.0f,
+                GRID_MARGIN     = 4.0f,     // room for jumping above or falling out of the map
+                CAPTURE_MARGIN  = 2.0f;     // the camera can move a bit before the next capture
+
+GLuint  Scene::s_map_texture_id    = 0,
+        Scene::s_font_texture_id   = 0,
+        Scene::s_sprite_texture_id = 0;
+
+Scene::Scene() :
+g_map_texture_id(s_map_texture_id), g_font_texture_id(s_font_texture_id),
+g_sprite_texture_id(s_sprite_texture_id) { }
+
+void Scene::request_textures() {
+    // These are only queued here; the ids get filled in once the loader has uploaded them
+    AssetLoader::request_texture(MAP_TILESET_FILEPATH, &s_map_texture_id);
+    AssetLoader::request_texture(FONTSHEET_FILEPATH, &s_font_texture_id);
+    AssetLoader::request_texture(SPRITESHEET_FILEPATH, &s_sprite_texture_id);
+}
+
+void Scene::preload() {
+    if (m_is_preloading or m_is_ready) return;
+    m_is_preloading = true;
+    
+    // initialise() only builds the map and entities on the CPU (the textures it
+    // uses are already uploaded), so it is safe to run off the main thread
+    AssetLoader::run_job([this] { initialise(); index_entities(); save_state(m_checkpoint); },
+                         [this] { m_is_ready = true; m_is_preloading = false; });
+}
+
+void Scene::build() {
+    if (m_is_preloading or m_is_ready) return;
+    initialise();
+    index_entities();
+    save_state(m_checkpoint);
+    m_is_ready = true;
+}
+
+void Scene::wait_until_ready() {
+    // Only blocks if the player got here before the background build finished.
+    // m_is_ready is set from the upload queue, so off the main thread all we can
+    // do is wait for the main thread to get to it
+    preload();
+    while (not m_is_ready) {
+        if (not AssetLoader::is_main_thread()) SDL_Delay(1);
+        else if (AssetLoader::pump_uploads() == 0) SDL_Delay(1);
+    }
+}
+
+void Scene::index_entities() {
+    Map *map = m_game_state.map;
+    Bounds world = { map->get_left_bound() - GRID_MARGIN, map->get_right_bound() + GRID_MARGIN,
+                     map->get_bottom_bound() - GRID_MARGIN, map->get_top_bound() + GRID_MARGIN };
+    m_entity_grid.reset(world, GRID_CELL_SIZE);
+    
+    // On the start screen the "player" is also enemies[0], so only file it once
+    m_indexed_entities.clear();
+    m_indexed_entities.push_back(m_game_state.player);
+    for (Entity *enemy : m_game_state.enemies)
+        if (enemy != m_game_state.player) m_indexed_entities.push_back(enemy);
+    if (m_game_state.partner) m_indexed_entities.push_back(m_game_state.partner);
+    
+    update_spatial_index();
+}
+
+void Scene::update_spatial_index() {
+    for (int id = 0; id < (int) m_indexed_entities.size(); id++) {
+        if (m_indexed_entities[id]->get_active_state())
+            m_entity_grid.move(id, m_indexed_entities[id]->get_bounds());
+        else m_entity_grid.remove(id);
+    }
+}
+
+void Scene::query_entities(const Bounds &area, std::vector<int> &ids) {
+    ids.clear();
+    m_entity_grid.query(area, ids);
+}
+
+void Scene::capture(RenderSnapshot &snapshot, const Bounds &visible) {
+    snapshot.scene = this;
+    snapshot.sprites.clear();
+    
+    // The grid is exact as of this step, but the render thread keeps drawing this
+    // snapshot while the camera moves on, so take a bit more than the screen
+    Bounds area = { visible.left - CAPTURE_MARGIN, visible.right + CAPTURE_MARGIN,
+                    visible.bottom - CAPTURE_MARGIN, visible.top + CAPTURE_MARGIN };
+    m_visible_ids.clear();
+    m_entity_grid.query(area, m_visible_ids);
+    for (int id : m_visible_ids)
+        if (m_indexed_entities[id]->get_active_state())
+            snapshot.sprites.push_back(m_indexed_entities[id]->get_snapshot());
+    
+    snapshot.player_previous_position = m_game_state.player->get_previous_pos();
+    snapshot.player_position          = m_game_state.player->get_pos();
+    snapshot.lives                    = *g_lives;
+}
+
+void Scene::render(ShaderProgram *program, const RenderSnapshot &snapshot, float alpha) {
+    m_game_state.map->render(program);
+    
+    // Entity::render_snapshot does the exact visibility test
+    for (const SpriteSnapshot &sprite : snapshot.sprites)
+        Entity::render_snapshot(program, sprite, alpha);
+    
+    render_hud(program);
+}
+
+Uint64 const Scene::get_state_hash(Uint64 hash) const {
+    for (Entity *entity : m_indexed_entities) {
+        vec3 position = entity->get_pos(),
+             velocity = entity->get_vel();
+        bool is_active = entity->get_active_state();
+        hash = Replay::hash(hash, &position[0], sizeof(float) * 3);
+        hash = Replay::hash(hash, &velocity[0], sizeof(float) * 3);
+        hash = Replay::hash(hash, &is_active, sizeof(is_active));
+    }
+    return hash;
+}
+
+void Scene::save_state(std::vector<Uint8> &blob) const {
+    SceneStateHeader header;
+    header.lives        = g_lives ? *g_lives : 0;
+    header.entity_count = (Uint32) m_indexed_entities.size();
+    
+    blob.resize(sizeof(header) + header.entity_count * sizeof(EntityState));
+    memcpy(blob.data(), &header, sizeof(header));
+    EntityState *states = (EntityState *) (blob.data() + sizeof(header));
+    for (int id = 0; id < (int) m_indexed_entities.size(); id++)
+        states[id] = m_indexed_entities[id]->save_state();
+}
+
+bool Scene::load_state(const std::vector<Uint8> &blob) {
+    SceneStateHeader header;
+    if (blob.size() < sizeof(header)) return false;
+    memcpy(&header, blob.data(), sizeof(header));
+    if (header.entity_count != m_indexed_entities.size()
+        or blob.size() != sizeof(header) + header.entity_count * sizeof(EntityState)) return false;
+    
+    if (g_lives) *g_lives = header.lives;
+    const EntityState *states = (const EntityState *) (blob.data() + sizeof(header));
+    for (int id = 0; id < (int) m_indexed_entities.size(); id++)
+        m_indexed_entities[id]->load_state(states[id]);
+    
+    update_spatial_index();
+    m_ai.reschedule();
+    m_scripts.restart();
+    return true;
+}
+
+void Scene::respawn() {
+    int lives = *g_lives;
+    load_state(m_checkpoint);
+    *g_lives = lives - 1;
+}
+
+void Scene::add_partner(glm::vec3 offset) {
+    if (m_game_state.partner) return;
+    
+    Entity *partner = new Entity(*m_game_state.player);
+    partner->init_anim();   // the copy's animation would still point at the player's
+    partner->set_pos(m_game_state.player->get_pos() + offset);
+    partner->update(m_game_state.map);
+    m_game_state.partner = partner;
+    
+    // It's part of the state from here on, and of what respawns restore
+    index_entities();
+    save_state(m_checkpoint);
+}
+
+bool Scene::move_player(Entity *player, const StepInput &input) {
+    player->set_mov(vec3(0.0f));
+    
+    bool jumped = input.jump and player->get_collided_bottom();
+    if (jumped) player->jump();
+    
+    if (input.left)         player->move_left();
+    else if (input.right)   player->move_right();
+    
+    if (length(player->get_mov()) > 1.0f)
+            player->normalize_movement();
+    return jumped;
+}
+
+void Scene::update_partner(float delta_time) {
+    Entity *partner = m_game_state.partner;
+    if (not partner) return;
+    
+    if (partner->get_active_state())
+        partner->update(m_game_state.map, delta_time, nullptr, m_game_state.enemies,
+                        (int) m_game_state.enemies.size());
+    if (partner->get_pos().y < -10.0f) partner->kill_off();
+    
+    // It was indexed last, so it's the last entity in the checkpoint
+    if (not partner->get_active_state()) {
+        const EntityState *states = (const EntityState *) (m_checkpoint.data() + sizeof(SceneStateHeader));
+        partner->load_state(states[m_indexed_entities.size() - 1]);
+    }
+}
+
+bool Scene::read_progress(const std::vector<Uint8> &blob, int *lives, int *enemies_left) const {
+    SceneStateHeader header;
+    if (blob.size() < sizeof(header)) return false;
+    memcpy(&header, blob.data(), sizeof(header));
+    if (header.entity_count != m_indexed_entities.size()
+        or blob.size() != sizeof(header) + header.entity_count * sizeof(EntityState)) return false;
+    
+    *lives = header.lives;
+    *enemies_left = 0;
+    const EntityState *states = (const EntityState *) (blob.data() + sizeof(header));
+    for (int id = 0; id < (int) m_indexed_entities.size(); id++)
+        if (m_indexed_entities[id]->get_entity_type() == ENEMY and (states[id].flags & STATE_ACTIVE))
+            (*enemies_left)++;
+    return true;
 }
@@ -9,7 +9,6 @@
 #endif
 
 #define GL_GLEXT_PROTOTYPES 1
-#include <SDL_mixer.h>
 #include <SDL.h>
 #include <SDL_opengl.h>
 #include "glm/mat4x4.hpp"
@@ -18,28 +17,85 @@
 #include "Utility.hpp"
 #include "Entity.hpp"
 #include "Map.hpp"
+#include "AssetLoader.hpp"
+#include "SpatialGrid.hpp"
+#include "InputQueue.hpp"
+#include "Script.hpp"
+#include "AIScheduler.hpp"
+#include <atomic>
 
 
 struct GameState
 {
-    Map *map;
-    Entity *player;
+    Map *map = nullptr;
+    Entity *player = nullptr;
+    Entity *partner = nullptr;      // the second player, in a networked game
     std::vector<Entity*> enemies;
     
-    Mix_Music *bgm;
-    Mix_Chunk *jump_sfx;
-    
     int next_scene_id;
 };
 
+class Scene;
+
+// A copy of what a frame needs to draw, taken after the simulation's fixed steps
+// so the render thread never reads entities while they're being updated
+struct RenderSnapshot {
+    Scene *scene = nullptr;
+    std::vector<SpriteSnapshot> sprites;    // only the ones near the camera
+    
+    glm::vec3   player_previous_position,
+                player_position;
+    int lives = 0;
+    bool    start_screen = false,   // the camera stays put
+            show_lives  = false,
+            won         = false,
+            lost        = false;
+    
+    // Leftover simulation time when this was taken, and when (performance counter)
+    float  accumulator = 0.0f;
+    Uint64 published_at = 0;
+};
+
 class Scene {
 protected:
-    int *g_lives;
+    int *g_lives = nullptr;
+    
+    // The loader flips m_is_ready from its upload queue (main thread) once
+    // initialise() has finished on the worker; the simulation thread waits on it
+    std::atomic<bool>   m_is_preloading { false },
+                        m_is_ready      { false };
+    
+    // The player and enemies filed by position, so rendering only visits the ones
+    // near the camera; ids are indices into m_indexed_entities (player first)
+    SpatialGrid m_entity_grid;
+    std::vector<Entity*> m_indexed_entities;
+    std::vector<int> m_visible_ids;
+    
+    void index_entities();
+    
+    // The scene as initialise() left it; respawn() goes back to this
+    std::vector<Uint8> m_checkpoint;
+    // For the levels' update(): back to the checkpoint, one life down
+    void respawn();
+    
+    // Behaviours written as coroutines; a level that spawns any in initialise()
+    // ticks them at the end of its update()
+    ScriptScheduler m_scripts;
+    // Spreads the enemies' decisions over steps; levels run it before updating them
+    AIScheduler m_ai;
+    
+    // Shared by every scene; see request_textures()
+    static GLuint s_map_texture_id,
+                  s_font_texture_id,
+                  s_sprite_texture_id;
+    
+    // Anything drawn on top of the entities; must only use state that doesn't change
+    virtual void render_hud(ShaderProgram *program) { }
 public:
     
     Scene();
     
-    virtual ~Scene() {}
+    virtual ~Scene() { delete m_game_state.partner; }
     
     GameState m_game_state;
     
@@ -50,8 +106,7 @@ public:
     static constexpr const char *SPRITESHEET_FILEPATH = "tilemap-characters_packed.png",
                         *FONTSHEET_FILEPATH = "font1.png",
                         *MAP_TILESET_FILEPATH = "tilemap_packed.png",
-                        *BGM_FILEPATH = "Sergio_music.mp3",
-                        *JUMP_SFX_FILEPATH = "jump.wav";
+                        *BACKGROUNDS_FILEPATH = "tilemap-backgrounds_packed.png";
     
     const glm::vec3 GRAVITY = glm::vec3(0.0f,-6.0f, 0.0f);
     
@@ -59,9 +114,57 @@ public:
     
     void set_lives(int *lives) { g_lives = lives; }
     
+    // Two-player games: a copy of the player, offset from it, that respawns (for
+    // free) wherever it started. Call once the scene is ready, before the first step
+    void add_partner(glm::vec3 offset);
+    // After update(): the partner moves on its own, against the same enemies
+    void update_partner(float delta_time);
+    // Sets a player's movement for the next update; true if it jumped
+    static bool move_player(Entity *player, const StepInput &input);
+    
+    // Main thread, once, before any scene is built. Scenes come and go (see
+    // SceneRegistry) and can be built on the simulation thread, so they copy these
+    // ids instead of asking the loader themselves
+    static void request_textures();
+    
+    // Runs initialise() on an AssetLoader worker while the current scene plays, so
+    // switching to this scene later is just a pointer swap
+    void preload();
+    void wait_until_ready();
+    // Builds it right here instead, on whatever thread this is, for scenes that are
+    // never drawn (see BatchEnv)
+    void build();
+    bool const is_ready() const { return m_is_ready; }
+    bool const is_preloading() const { return m_is_preloading; }
+    
+    // Call after each update so the grid follows the entities
+    void update_spatial_index();
+    // Ids of the active indexed entities filed near area, in ascending order
+    void query_entities(const Bounds &area, std::vector<int> &ids);
+    int const get_indexed_count() const { return (int) m_indexed_entities.size(); }
+    Entity *get_indexed_entity(int id) const { return m_indexed_entities[id]; }
+    
+    // Folds the player and enemies into hash (see Replay::hash), so two runs can
+    // be checked for having ended up in the same place
+    Uint64 const get_state_hash(Uint64 hash) const;
+    
+    // The whole simulation state of the scene (lives, then an EntityState per
+    // indexed entity) as one blob, for StateHistory. The maps never change while
+    // the game runs, so they aren't part of it
+    void save_state(std::vector<Uint8> &blob) const;
+    // False (and nothing changes) if blob wasn't saved from this scene. Scripts start
+    // over from the loaded state, since they aren't part of it
+    bool load_state(const std::vector<Uint8> &blob);
+    // Reads the lives and how many enemies are still up out of a saved blob
+    bool read_progress(const std::vector<Uint8> &blob, int *lives, int *enemies_left) const;
+    
     virtual void initialise() = 0;
     virtual void update(float delta_time) = 0;
-    virtual void render(ShaderProgram *program) = 0;
+    
+    // Simulation thread: copies out the indexed entities that overlap visible, in id order
+    void capture(RenderSnapshot &snapshot, const Bounds &visible);
+    // Render thread: the map, then the captured sprites alpha of the way between steps
+    void render(ShaderProgram *program, const RenderSnapshot &snapshot, float alpha);
     
     GameState const get_state()     const { return m_game_state; }
     int const get_num_of_enemies()  const { return m_number_of_enemies; }
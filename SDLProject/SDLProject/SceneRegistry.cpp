@@ -0,0 +1,94 @@
+// SceneRegistry.cpp
+#define LOG(argument) std::cout << argument << '\n'
+
+#include "SceneRegistry.hpp"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+    struct Slot {
+        SceneRegistry::Factory factory;
+        Scene *scene = nullptr;
+    };
+
+    std::mutex g_mutex;
+    std::vector<Slot> g_slots;
+    std::vector<Scene*> g_retired;
+}
+
+int SceneRegistry::add(Factory factory) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    Slot slot;
+    slot.factory = factory;
+    g_slots.push_back(slot);
+    return (int) g_slots.size() - 1;
+}
+
+int SceneRegistry::get_count() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return (int) g_slots.size();
+}
+
+Scene *SceneRegistry::get(int index) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (index < 0 or index >= (int) g_slots.size()) return nullptr;
+
+    Slot &slot = g_slots[index];
+    if (not slot.scene) slot.scene = slot.factory();
+    return slot.scene;
+}
+
+Scene *SceneRegistry::create(int index) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (index < 0 or index >= (int) g_slots.size()) return nullptr;
+    return g_slots[index].factory();
+}
+
+void SceneRegistry::preload(int index) {
+    Scene *scene = get(index);
+    if (scene) scene->preload();
+}
+
+void SceneRegistry::release(int index) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (index < 0 or index >= (int) g_slots.size() or not g_slots[index].scene) return;
+
+    g_retired.push_back(g_slots[index].scene);
+    g_slots[index].scene = nullptr;
+}
+
+void SceneRegistry::collect(const Scene *in_use) {
+    std::vector<Scene*> doomed;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        if (g_retired.empty()) return;
+
+        // A worker could still be in initialise() if a scene was left before it finished
+        auto keep = std::partition(g_retired.begin(), g_retired.end(), [in_use] (Scene *scene) {
+            return scene == in_use or scene->is_preloading();
+        });
+        doomed.assign(keep, g_retired.end());
+        g_retired.erase(keep, g_retired.end());
+    }
+
+    // Outside the lock: tearing down a level isn't free, and the simulation may want get()
+    for (Scene *scene : doomed) delete scene;
+}
+
+void SceneRegistry::release_all() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    for (Slot &slot : g_slots) {
+        delete slot.scene;
+        slot.scene = nullptr;
+    }
+    for (Scene *scene : g_retired) delete scene;
+    g_retired.clear();
+}
+
+int SceneRegistry::get_resident_count() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    int count = (int) g_retired.size();
+    for (const Slot &slot : g_slots)
+        if (slot.scene) count++;
+    return count;
+}
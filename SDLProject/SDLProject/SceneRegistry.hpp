@@ -0,0 +1,43 @@
+#ifndef SCENEREGISTRY_H
+#define SCENEREGISTRY_H
+
+#pragma once
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "Scene.hpp"
+
+// Every scene in the game, by index, built the first time something asks for it
+// and deleted again once it has been left. Only the scene being played, the one
+// after it (preloading) and one that's just been left are ever resident, so
+// startup only pays for the first scene and memory doesn't grow with the level count.
+//
+// A scene that's been left may still be in a RenderSnapshot the renderer is
+// drawing, so release() only retires it; collect() deletes it once the renderer
+// has moved on.
+class SceneRegistry {
+public:
+    typedef std::function<Scene*()> Factory;
+
+    // Set-up: returns the new scene's index
+    static int add(Factory factory);
+    static int get_count();
+
+    // Any thread. Builds the scene if it isn't resident; returns nullptr past the end
+    static Scene *get(int index);
+    // Builds the scene and starts its initialise() on a loader worker
+    static void preload(int index);
+    // Hands the scene to collect(); the next get() builds a fresh one
+    static void release(int index);
+    // A separate copy of the scene that the registry doesn't track; the caller deletes it
+    static Scene *create(int index);
+
+    // Main thread: deletes retired scenes other than in_use (which may be nullptr)
+    static void collect(const Scene *in_use);
+    // Shutdown, once nothing is rendering or loading
+    static void release_all();
+
+    static int get_resident_count();
+};
+
+#endif // SCENEREGISTRY_H
@@ -0,0 +1,163 @@
+// Script.cpp
+#include "Script.hpp"
+#include <algorithm>
+
+/* ----- POOL ----- */
+
+thread_local ScriptPool *ScriptPool::s_current = nullptr;
+
+namespace {
+    // Every frame starts with the pool it came from (nullptr for plain new), so
+    // operator delete can give it back without being told
+    constexpr size_t FRAME_HEADER = 16;
+}
+
+ScriptPool::~ScriptPool() {
+    for (Uint8 *chunk : m_chunks) delete[] chunk;
+}
+
+void *ScriptPool::allocate(size_t size) {
+    int size_class = (int) ((size + BLOCK_SIZE - 1) / BLOCK_SIZE) - 1;
+    if (size_class >= SIZE_CLASSES) return ::operator new(size);
+
+    if (m_free[size_class]) {
+        FreeBlock *block = m_free[size_class];
+        m_free[size_class] = block->next;
+        return block;
+    }
+
+    int bytes = (size_class + 1) * BLOCK_SIZE;
+    if (m_chunk_used + bytes > CHUNK_SIZE) {
+        m_chunks.push_back(new Uint8[CHUNK_SIZE]);
+        m_chunk_used = 0;
+    }
+    void *block = m_chunks.back() + m_chunk_used;
+    m_chunk_used += bytes;
+    return block;
+}
+
+void ScriptPool::deallocate(void *block, size_t size) {
+    int size_class = (int) ((size + BLOCK_SIZE - 1) / BLOCK_SIZE) - 1;
+    if (size_class >= SIZE_CLASSES) {
+        ::operator delete(block);
+        return;
+    }
+    FreeBlock *free_block = (FreeBlock*) block;
+    free_block->next = m_free[size_class];
+    m_free[size_class] = free_block;
+}
+
+void *Script::promise_type::operator new(size_t size) {
+    ScriptPool *pool = ScriptPool::s_current;
+    Uint8 *block = (Uint8*) (pool ? pool->allocate(size + FRAME_HEADER) : ::operator new(size + FRAME_HEADER));
+    *(ScriptPool**) block = pool;
+    return block + FRAME_HEADER;
+}
+
+void Script::promise_type::operator delete(void *frame, size_t size) {
+    Uint8 *block = (Uint8*) frame - FRAME_HEADER;
+    ScriptPool *pool = *(ScriptPool**) block;
+    if (pool) pool->deallocate(block, size + FRAME_HEADER);
+    else ::operator delete(block);
+}
+
+/* ----- SCHEDULER ----- */
+
+Uint32 ScriptScheduler::get_events(const Entity *entity) {
+    bool facing_right = entity->get_facing_right();
+    Uint32 events = 0;
+    if (facing_right ? entity->get_collided_right() : entity->get_collided_left()) events |= EVENT_WALL;
+    // In the air there's nothing under either side
+    if (entity->get_collided_bottom() and (facing_right ? entity->get_gap_bottom_right() : entity->get_gap_bottom_left()))
+        events |= EVENT_LEDGE;
+    if (entity->get_collided_bottom()) events |= EVENT_LANDED;
+    if (not entity->get_active_state()) events |= EVENT_DEAD;
+    return events;
+}
+
+void ScriptScheduler::spawn(Starter starter) {
+    m_starters.push_back(starter);
+    start(starter);
+}
+
+void ScriptScheduler::start(const Starter &starter) {
+    ScriptPool *previous = ScriptPool::s_current;
+    ScriptPool::s_current = &m_pool;
+    Script::Handle handle = starter().release();
+    ScriptPool::s_current = previous;
+
+    handle.promise().slot = (int) m_scripts.size();
+    m_scripts.push_back(handle);
+
+    // Up to its first wait
+    handle.resume();
+    if (handle.done()) finish(handle);
+}
+
+// Backwards, since the std heap functions keep the largest at the front
+bool ScriptScheduler::is_later(const Timer &a, const Timer &b) {
+    return a.due != b.due ? a.due > b.due : a.order > b.order;
+}
+
+void ScriptScheduler::add_timer(double due, Script::Handle handle) {
+    m_timers.push_back({ due, m_next_order++, handle });
+    std::push_heap(m_timers.begin(), m_timers.end(), is_later);
+}
+
+void ScriptScheduler::tick(float delta_time) {
+    m_time += delta_time;
+
+    while (not m_timers.empty() and m_timers.front().due <= m_time) {
+        std::pop_heap(m_timers.begin(), m_timers.end(), is_later);
+        m_ready.push_back(m_timers.back().handle);
+        m_timers.pop_back();
+    }
+
+    // Swapping the last one in keeps this from shuffling the whole list
+    for (size_t i = 0; i < m_waiters.size(); ) {
+        if (get_events(m_waiters[i].entity) & m_waiters[i].events) {
+            m_ready.push_back(m_waiters[i].handle);
+            m_waiters[i] = m_waiters.back();
+            m_waiters.pop_back();
+        } else i++;
+    }
+
+    resume_ready();
+}
+
+void ScriptScheduler::resume_ready() {
+    // A script that wakes up and waits again lands in m_timers or m_waiters, not
+    // here, so this can't go round forever
+    for (size_t i = 0; i < m_ready.size(); i++) {
+        Script::Handle handle = m_ready[i];
+        handle.resume();
+        if (handle.done()) finish(handle);
+    }
+    m_ready.clear();
+}
+
+void ScriptScheduler::finish(Script::Handle handle) {
+    int slot = handle.promise().slot;
+    m_scripts[slot] = m_scripts.back();
+    m_scripts[slot].promise().slot = slot;
+    m_scripts.pop_back();
+    handle.destroy();
+}
+
+void ScriptScheduler::destroy_all() {
+    for (Script::Handle handle : m_scripts) handle.destroy();
+    m_scripts.clear();
+    m_timers.clear();
+    m_waiters.clear();
+    m_ready.clear();
+}
+
+void ScriptScheduler::restart() {
+    destroy_all();
+    for (const Starter &starter : m_starters) start(starter);
+}
+
+void ScriptScheduler::clear() {
+    destroy_all();
+    m_starters.clear();
+}
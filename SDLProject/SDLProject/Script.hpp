@@ -0,0 +1,160 @@
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+#pragma once
+#include <SDL.h>
+#include <coroutine>
+#include <functional>
+#include <vector>
+#include "Entity.hpp"
+
+// Coroutine frames, carved out of a scheduler's own chunks and recycled through a
+// free list per size class. A script's frame is the same size every time it
+// starts, so once a scene has run its scripts once they never allocate again
+class ScriptPool {
+private:
+    static constexpr int    BLOCK_SIZE  = 64,
+                            SIZE_CLASSES = 32,          // frames up to 2 KB; bigger ones use new
+                            CHUNK_SIZE  = 16 * 1024;
+
+    struct FreeBlock { FreeBlock *next; };
+
+    FreeBlock *m_free[SIZE_CLASSES] = { nullptr };
+    std::vector<Uint8*> m_chunks;
+    int m_chunk_used = CHUNK_SIZE;                      // of the last chunk
+
+public:
+    ~ScriptPool();
+
+    void *allocate(size_t size);
+    void deallocate(void *block, size_t size);
+
+    int const get_chunk_count() const { return (int) m_chunks.size(); }
+
+    // The pool frames started on this thread come from; set by ScriptScheduler::spawn
+    static thread_local ScriptPool *s_current;
+};
+
+// What a script function returns: write one as a coroutine that takes its
+// scheduler and co_awaits wait() and until() on it. It doesn't run until it's
+// handed to ScriptScheduler::spawn
+class Script {
+public:
+    struct promise_type {
+        int slot = -1;                                  // in the scheduler's list of live scripts
+
+        Script get_return_object() { return Script(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }    // the scheduler cleans up
+        void return_void() { }
+        void unhandled_exception() { std::terminate(); }
+
+        static void *operator new(size_t size);
+        static void operator delete(void *frame, size_t size);
+    };
+    typedef std::coroutine_handle<promise_type> Handle;
+
+private:
+    Handle m_handle;
+
+public:
+    explicit Script(Handle handle) : m_handle(handle) { }
+    Script(Script &&other) : m_handle(other.m_handle) { other.m_handle = nullptr; }
+    Script(const Script&) = delete;
+    ~Script() { if (m_handle) m_handle.destroy(); }
+
+    Handle release() { Handle handle = m_handle; m_handle = nullptr; return handle; }
+};
+
+// What until() can wait for, as seen by the entity after its last update. Walls
+// and ledges only count in the direction it's facing
+enum ScriptEvent {
+    EVENT_WALL      = 1,
+    EVENT_LEDGE     = 2,    // on the ground, enemies only; see Entity::check_platform_x
+    EVENT_LANDED    = 4,
+    EVENT_DEAD      = 8
+};
+
+// Runs a scene's scripts. A script only costs anything when what it's waiting for
+// happens: timers sit in a heap ordered by when they're due, and until() waits are
+// a flag test per waiting script each tick, with the coroutine only resumed once
+// the test passes. Nothing is allocated per tick once the lists have grown.
+//
+// Scripts aren't part of Scene::save_state (a coroutine frame can't be saved), so
+// loading a state restarts every script from the top. Write them as loops that
+// look at the world, so starting over from wherever their entity is works.
+class ScriptScheduler {
+public:
+    typedef std::function<Script()> Starter;
+
+private:
+    struct Timer {
+        double due;
+        Uint32 order;                                   // ties go in the order they were set
+        Script::Handle handle;
+    };
+    struct Waiter {
+        Entity *entity;
+        Uint32 events;
+        Script::Handle handle;
+    };
+
+    ScriptPool m_pool;
+    std::vector<Starter> m_starters;
+    std::vector<Script::Handle> m_scripts,              // alive, by promise slot
+                                m_ready;
+    std::vector<Timer> m_timers;                        // a min-heap on (due, order)
+    std::vector<Waiter> m_waiters;
+    double m_time = 0.0;
+    Uint32 m_next_order = 0;
+
+    void start(const Starter &starter);
+    void resume_ready();
+    void finish(Script::Handle handle);
+    void destroy_all();
+    static bool is_later(const Timer &a, const Timer &b);
+
+public:
+    struct WaitAwaiter {
+        ScriptScheduler &scheduler;
+        double due;
+
+        bool await_ready() const { return due <= scheduler.m_time; }
+        void await_suspend(Script::Handle handle) { scheduler.add_timer(due, handle); }
+        void await_resume() const { }
+    };
+    struct UntilAwaiter {
+        ScriptScheduler &scheduler;
+        Entity *entity;
+        Uint32 events;
+
+        bool await_ready() const { return (get_events(entity) & events) != 0; }
+        void await_suspend(Script::Handle handle) { scheduler.m_waiters.push_back({ entity, events, handle }); }
+        void await_resume() const { }
+    };
+
+    ScriptScheduler() = default;
+    ScriptScheduler(const ScriptScheduler&) = delete;
+    ~ScriptScheduler() { clear(); }
+
+    // Starts a script now, and again from the top whenever restart() is called
+    void spawn(Starter starter);
+    // After the entities have updated: everything whose time or event has come runs
+    // until its next wait
+    void tick(float delta_time);
+    // Every script back to its start (see Scene::load_state)
+    void restart();
+    // Every script gone, frames back to the pool
+    void clear();
+
+    WaitAwaiter wait(float seconds) { return { *this, m_time + seconds }; }
+    UntilAwaiter until(Entity *entity, Uint32 events) { return { *this, entity, events }; }
+
+    void add_timer(double due, Script::Handle handle);
+    static Uint32 get_events(const Entity *entity);
+
+    int const get_script_count() const { return (int) m_scripts.size(); }
+    const ScriptPool &get_pool() const { return m_pool; }
+};
+
+#endif // SCRIPT_H
@@ -1,6 +1,94 @@
 #define GL_SILENCE_DEPRECATION
 
 #include "ShaderProgram.h"
+#include <SDL.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+namespace {
+    // Program binaries are GL 4.1 / ARB_get_program_binary, which the headers we
+    // build against may not declare, so they're looked up at runtime
+    typedef void (APIENTRY *GetProgramBinaryProc)(GLuint, GLsizei, GLsizei*, GLenum*, void*);
+    typedef void (APIENTRY *ProgramBinaryProc)(GLuint, GLenum, const void*, GLsizei);
+    typedef void (APIENTRY *ProgramParameteriProc)(GLuint, GLenum, GLint);
+    
+    struct ProgramBinaryFunctions {
+        bool checked = false,
+             supported = false;
+        GetProgramBinaryProc  getProgramBinary  = nullptr;
+        ProgramBinaryProc     programBinary     = nullptr;
+        ProgramParameteriProc programParameteri = nullptr;
+    };
+    
+    ProgramBinaryFunctions &GetBinaryFunctions() {
+        static ProgramBinaryFunctions functions;
+        if (functions.checked) return functions;
+        functions.checked = true;
+        
+        if (not SDL_GL_ExtensionSupported("GL_ARB_get_program_binary")) return functions;
+        functions.getProgramBinary  = (GetProgramBinaryProc)  SDL_GL_GetProcAddress("glGetProgramBinary");
+        functions.programBinary     = (ProgramBinaryProc)     SDL_GL_GetProcAddress("glProgramBinary");
+        functions.programParameteri = (ProgramParameteriProc) SDL_GL_GetProcAddress("glProgramParameteri");
+        
+        // Some drivers have the extension but no formats to save in
+        GLint formatCount = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        functions.supported = functions.getProgramBinary and functions.programBinary
+                              and functions.programParameteri and formatCount > 0;
+        return functions;
+    }
+    
+    const char     CACHE_MAGIC[4] = { 'S', 'P', 'B', 'C' };
+    const uint32_t CACHE_VERSION  = 1;
+    
+    struct CacheHeader {
+        char     magic[4];
+        uint32_t version;
+        uint64_t key;
+        uint32_t format;    // the GLenum glGetProgramBinary gave us
+        uint32_t length;
+    };
+    
+    // FNV-1a, continuing from hash
+    uint64_t Hash(uint64_t hash, const char *data, size_t length) {
+        for (size_t i = 0; i < length; i++) {
+            hash ^= (unsigned char) data[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+    
+    // A binary is only good for the exact sources and the exact driver that made it
+    uint64_t CacheKey(const std::string &vertexSource, const std::string &fragmentSource) {
+        uint64_t key = 14695981039346656037ull;
+        const std::string parts[] = {
+            vertexSource, fragmentSource,
+            (const char *) glGetString(GL_VENDOR), (const char *) glGetString(GL_RENDERER),
+            (const char *) glGetString(GL_VERSION)
+        };
+        for (const std::string &part : parts)
+            key = Hash(key, part.c_str(), part.size() + 1);   // the '\0' keeps "ab"+"c" apart from "a"+"bc"
+        return key;
+    }
+    
+    std::string CachePath(const std::string &cacheDirectory, uint64_t key) {
+        char name[32];
+        snprintf(name, sizeof(name), "shader_%016llx.bin", (unsigned long long) key);
+        return cacheDirectory + name;
+    }
+}
 
 void ShaderProgram::Load(const char *vertexShaderFile, const char *fragmentShaderFile) {
     
@@ -9,10 +97,104 @@ void ShaderProgram::Load(const char *vertexShaderFile, const char *fragmentShade
     // create the fragment shader
     fragmentShader = LoadShaderFromFile(fragmentShaderFile, GL_FRAGMENT_SHADER);
     
+    LinkProgram();
+}
+
+void ShaderProgram::LoadFromSource(const std::string &vertexSource, const std::string &fragmentSource) {
+    
+    // same as Load, for sources that were already read in (e.g. by the asset loader)
+    vertexShader = LoadShaderFromString(vertexSource, GL_VERTEX_SHADER);
+    fragmentShader = LoadShaderFromString(fragmentSource, GL_FRAGMENT_SHADER);
+    
+    LinkProgram();
+}
+
+void ShaderProgram::LoadCached(const std::string &vertexSource, const std::string &fragmentSource,
+                               const std::string &cacheDirectory) {
+    
+    loadedFromCache = false;
+    ProgramBinaryFunctions &binary = GetBinaryFunctions();
+    if (cacheDirectory.empty() or not binary.supported) {
+        LoadFromSource(vertexSource, fragmentSource);
+        return;
+    }
+    
+    uint64_t key = CacheKey(vertexSource, fragmentSource);
+    std::string path = CachePath(cacheDirectory, key);
+    
+    // Try the cache first; anything off about the file just means a fresh compile
+    std::ifstream infile(path, std::ios::binary);
+    CacheHeader header;
+    if (infile.read((char *) &header, sizeof(header))
+        and memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0
+        and header.version == CACHE_VERSION and header.key == key) {
+        
+        // The length comes off disk too, so it has to fit in what's left of the file
+        std::streampos start = infile.tellg();
+        infile.seekg(0, std::ios::end);
+        std::streamoff remaining = infile.tellg() - start;
+        infile.seekg(start);
+        
+        std::vector<char> data;
+        if (header.length > 0 and remaining >= (std::streamoff) header.length) data.resize(header.length);
+        if (not data.empty() and infile.read(data.data(), data.size())) {
+            programID = glCreateProgram();
+            binary.programBinary(programID, header.format, data.data(), (GLsizei) data.size());
+            
+            // The driver can still turn it down, e.g. after an update that kept the version string
+            GLint linkSuccess;
+            glGetProgramiv(programID, GL_LINK_STATUS, &linkSuccess);
+            if (linkSuccess == GL_TRUE) {
+                vertexShader = 0;
+                fragmentShader = 0;
+                loadedFromCache = true;
+                LookUpLocations();
+                return;
+            }
+            glDeleteProgram(programID);
+        }
+    }
+    infile.close();
+    
+    retrievableBinary = true;
+    LoadFromSource(vertexSource, fragmentSource);
+    retrievableBinary = false;
+    
+    GLint linkSuccess, length = 0;
+    glGetProgramiv(programID, GL_LINK_STATUS, &linkSuccess);
+    glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (linkSuccess == GL_FALSE or length <= 0) return;
+    
+    std::vector<char> data(length);
+    GLenum format;
+    binary.getProgramBinary(programID, length, &length, &format, data.data());
+    
+    header = { { CACHE_MAGIC[0], CACHE_MAGIC[1], CACHE_MAGIC[2], CACHE_MAGIC[3] },
+               CACHE_VERSION, key, (uint32_t) format, (uint32_t) length };
+    
+    // Written to the side and then moved over, so a crash can't leave half a file
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream outfile(tempPath, std::ios::binary | std::ios::trunc);
+        outfile.write((const char *) &header, sizeof(header));
+        outfile.write(data.data(), length);
+        if (not outfile) {
+            std::cout << "Couldn't write shader cache " << tempPath << std::endl;
+            return;
+        }
+    }
+    std::remove(path.c_str());
+    std::rename(tempPath.c_str(), path.c_str());
+}
+
+void ShaderProgram::LinkProgram() {
+    
     // Create the final shader program from our vertex and fragment shaders
     programID = glCreateProgram();
     glAttachShader(programID, vertexShader);
     glAttachShader(programID, fragmentShader);
+    if (retrievableBinary)
+        GetBinaryFunctions().programParameteri(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(programID);
     
     GLint linkSuccess;
@@ -21,6 +203,11 @@ void ShaderProgram::Load(const char *vertexShaderFile, const char *fragmentShade
 	printf("Error linking shader program!\n");
     }
     
+    LookUpLocations();
+}
+
+void ShaderProgram::LookUpLocations() {
+    
     modelMatrixUniform = glGetUniformLocation(programID, "modelMatrix");
     projectionMatrixUniform = glGetUniformLocation(programID, "projectionMatrix");
     viewMatrixUniform = glGetUniformLocation(programID, "viewMatrix");
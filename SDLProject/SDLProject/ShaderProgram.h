@@ -15,6 +15,13 @@ class ShaderProgram {
     public:
 	
 		void Load(const char *vertexShaderFile, const char *fragmentShaderFile);
+		void LoadFromSource(const std::string &vertexSource, const std::string &fragmentSource);
+		// Like LoadFromSource, but reuses the program binary cached in cacheDirectory
+		// (which should end in a slash) when the sources and driver still match, and
+		// caches a freshly linked one otherwise. Falls back to a plain compile if the
+		// driver can't hand out binaries or cacheDirectory is empty
+		void LoadCached(const std::string &vertexSource, const std::string &fragmentSource,
+		                const std::string &cacheDirectory);
 		void Cleanup();
 
 		void SetModelMatrix(const glm::mat4 &matrix);
@@ -25,9 +32,14 @@ class ShaderProgram {
 	
         GLuint LoadShaderFromString(const std::string &shaderContents, GLenum type);
         GLuint LoadShaderFromFile(const std::string &shaderFile, GLenum type);
+        void LinkProgram();
+        void LookUpLocations();
     
         GLuint programID;
     
+        bool retrievableBinary = false;   // ask the driver to keep the binary around at link time
+        bool loadedFromCache = false;
+    
         GLuint projectionMatrixUniform;
         GLuint modelMatrixUniform;
         GLuint viewMatrixUniform;
@@ -0,0 +1,304 @@
+// SnapshotServer.cpp
+#define LOG(argument) std::cout << argument << '\n'
+
+#include "SnapshotServer.hpp"
+#include "BitStream.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+constexpr float MICROSECONDS_IN_SECOND = 1000000.0f;
+
+namespace {
+    const Uint8  SNAPSHOT_MAGIC = 0x53;         // 'S', first byte of every snapshot
+    const Uint32 VIEW_MAGIC     = 0x31564e53;   // "SNV1"
+
+    // Client to server: the latest snapshot it has, and what it's looking at
+    struct ViewPacket {
+        Uint32 magic,
+               acked;
+        float  left, right, bottom, top;
+    };
+
+    const float POSITION_SCALE = 64.0f,         // positions go over the wire in 1/64ths
+                VIEW_MARGIN    = 1.0f;          // so things walking into view are already there
+
+    const int   POSITION_BITS   = 24,
+                DELTA_BITS      = 8,            // a position that moved less than 2 units
+                ID_BITS         = 16,
+                ANIMATION_BITS  = 8,
+                FLAG_BITS       = 1,
+                SEQUENCE_BITS   = 32,
+                BASELINE_BITS   = 8,
+                SCENE_BITS      = 8,
+                LIVES_BITS      = 8,
+                COUNT_BITS      = 8;
+
+    bool fits(Sint32 value, int bits) {
+        return value >= -(1 << (bits - 1)) and value < (1 << (bits - 1));
+    }
+
+    void write_position(BitWriter &writer, Sint32 value, const Sint32 *base) {
+        if (base) {
+            writer.write_bool(value != *base);
+            if (value == *base) return;
+            bool small = fits(value - *base, DELTA_BITS);
+            writer.write_bool(small);
+            if (small) {
+                writer.write_signed(value - *base, DELTA_BITS);
+                return;
+            }
+        }
+        writer.write_signed(value, POSITION_BITS);
+    }
+
+    Sint32 read_position(BitReader &reader, const Sint32 *base) {
+        if (base) {
+            if (not reader.read_bool()) return *base;
+            if (reader.read_bool()) return *base + reader.read_signed(DELTA_BITS);
+        }
+        return reader.read_signed(POSITION_BITS);
+    }
+
+    bool same_entity(const NetEntity &a, const NetEntity &b) {
+        return a.x == b.x and a.y == b.y and a.animation_index == b.animation_index and a.flags == b.flags;
+    }
+
+    // Entities go in id order, so an id is usually one more than the last and costs
+    // a bit. Each one is either new to the client, in full, or a change from the
+    // baseline's copy of it: one bit if nothing moved
+    void write_snapshot(BitWriter &writer, const Snapshot &snapshot, const Snapshot *baseline) {
+        writer.write(SNAPSHOT_MAGIC, 8);
+        writer.write(snapshot.sequence, SEQUENCE_BITS);
+        writer.write_bool(baseline != nullptr);
+        if (baseline) writer.write(snapshot.sequence - baseline->sequence, BASELINE_BITS);
+        writer.write(snapshot.scene, SCENE_BITS);
+        writer.write(snapshot.lives, LIVES_BITS);
+        writer.write((Uint32) snapshot.entities.size(), COUNT_BITS);
+
+        int previous_id = -1;
+        size_t base_index = 0;
+        for (const NetEntity &entity : snapshot.entities) {
+            writer.write_bool(entity.id == previous_id + 1);
+            if (entity.id != previous_id + 1) writer.write(entity.id, ID_BITS);
+            previous_id = entity.id;
+
+            const NetEntity *base = nullptr;
+            if (baseline) {
+                while (base_index < baseline->entities.size() and baseline->entities[base_index].id < entity.id) base_index++;
+                if (base_index < baseline->entities.size() and baseline->entities[base_index].id == entity.id)
+                    base = &baseline->entities[base_index];
+            }
+
+            if (base) {
+                bool changed = not same_entity(entity, *base);
+                writer.write_bool(changed);
+                if (not changed) continue;
+            }
+            write_position(writer, entity.x, base ? &base->x : nullptr);
+            write_position(writer, entity.y, base ? &base->y : nullptr);
+            if (base) writer.write_bool(entity.animation_index != base->animation_index);
+            if (not base or entity.animation_index != base->animation_index)
+                writer.write(entity.animation_index, ANIMATION_BITS);
+            writer.write(entity.flags, FLAG_BITS);
+        }
+    }
+}
+
+/* ----- SERVER ----- */
+
+SnapshotServer::~SnapshotServer() {
+    for (Client *client : m_clients) {
+        delete client->transport;
+        delete client;
+    }
+}
+
+int SnapshotServer::add_client(Transport *transport) {
+    Client *client = new Client();
+    client->transport = transport;
+    m_clients.push_back(client);
+    return (int) m_clients.size() - 1;
+}
+
+void SnapshotServer::tick(Scene *scene, int scene_index, int lives) {
+    for (Client *client : m_clients) {
+        receive(*client);
+        // Nothing to go on until it's said what it can see
+        if (client->has_view) send_snapshot(*client, scene, scene_index, lives);
+    }
+}
+
+void SnapshotServer::receive(Client &client) {
+    Uint8 buffer[Transport::MAX_PACKET_SIZE];
+    int length;
+    while ((length = client.transport->receive(buffer)) > 0) {
+        ViewPacket packet;
+        if (length < (int) sizeof(packet)) continue;
+        memcpy(&packet, buffer, sizeof(packet));
+        if (packet.magic != VIEW_MAGIC or packet.acked >= client.next_sequence) continue;
+
+        // Out of order views are a step behind at worst, so just take the latest ack's
+        if (packet.acked < client.acked) continue;
+        client.acked    = packet.acked;
+        client.view     = { packet.left, packet.right, packet.bottom, packet.top };
+        client.has_view = true;
+    }
+}
+
+void SnapshotServer::send_snapshot(Client &client, Scene *scene, int scene_index, int lives) {
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    Bounds area = { client.view.left - VIEW_MARGIN, client.view.right + VIEW_MARGIN,
+                    client.view.bottom - VIEW_MARGIN, client.view.top + VIEW_MARGIN };
+    scene->query_entities(area, m_ids);
+
+    // A crowd bigger than a packet keeps the ones nearest the middle of the view
+    if (m_ids.size() > MAX_VIEW_ENTITIES) {
+        glm::vec3 centre = glm::vec3((area.left + area.right) / 2.0f, (area.bottom + area.top) / 2.0f, 0.0f);
+        auto distance = [scene, centre] (int id) { return glm::distance(scene->get_indexed_entity(id)->get_pos(), centre); };
+        std::nth_element(m_ids.begin(), m_ids.begin() + MAX_VIEW_ENTITIES, m_ids.end(),
+                         [&distance] (int a, int b) { return distance(a) < distance(b); });
+        m_ids.resize(MAX_VIEW_ENTITIES);
+        std::sort(m_ids.begin(), m_ids.end());
+    }
+
+    Uint32 sequence = client.next_sequence++;
+    Snapshot &snapshot = client.sent[sequence % SENT_HISTORY];
+    snapshot.sequence = sequence;
+    snapshot.scene    = (Uint8) scene_index;
+    snapshot.lives    = (Uint8) std::max(0, lives);
+    snapshot.entities.clear();
+    for (int id : m_ids) {
+        Entity *entity = scene->get_indexed_entity(id);
+        NetEntity net;
+        net.id              = (Uint16) id;
+        net.x               = (Sint32) lroundf(entity->get_pos().x * POSITION_SCALE);
+        net.y               = (Sint32) lroundf(entity->get_pos().y * POSITION_SCALE);
+        net.animation_index = (Uint8) entity->get_anim_index();
+        net.flags           = entity->get_facing_right() ? NET_FACING_RIGHT : 0;
+        snapshot.entities.push_back(net);
+    }
+
+    // Only ever against something the client is known to have. A new level starts
+    // over, since the ids don't mean the same things any more
+    const Snapshot *baseline = nullptr;
+    if (client.acked != 0 and sequence - client.acked < SENT_HISTORY) {
+        const Snapshot &acked = client.sent[client.acked % SENT_HISTORY];
+        if (acked.sequence == client.acked and acked.scene == snapshot.scene) baseline = &acked;
+    }
+
+    Uint8 buffer[Transport::MAX_PACKET_SIZE];
+    BitWriter writer(buffer, sizeof(buffer));
+    write_snapshot(writer, snapshot, baseline);
+    if (writer.has_overflowed()) {
+        // Can't happen with MAX_VIEW_ENTITIES in full, but don't send half a snapshot
+        LOG("Snapshot " << sequence << " didn't fit in a packet.");
+        snapshot.sequence = 0;
+        return;
+    }
+    client.transport->send(buffer, writer.get_bytes());
+
+    float elapsed_us = (float) (SDL_GetPerformanceCounter() - start) * MICROSECONDS_IN_SECOND
+                     / (float) SDL_GetPerformanceFrequency();
+    client.stats.packets++;
+    client.stats.entities        += (int) snapshot.entities.size();
+    client.stats.bytes           += writer.get_bytes();
+    client.stats.total_encode_us += elapsed_us;
+    client.stats.peak_encode_us   = std::max(client.stats.peak_encode_us, elapsed_us);
+}
+
+const Snapshot *SnapshotServer::get_sent(int client, Uint32 sequence) const {
+    const Snapshot &sent = m_clients[client]->sent[sequence % SENT_HISTORY];
+    return sent.sequence == sequence ? &sent : nullptr;
+}
+
+/* ----- CLIENT ----- */
+
+void SnapshotClient::update(const Bounds &view) {
+    Uint8 buffer[Transport::MAX_PACKET_SIZE];
+    int length;
+    while ((length = m_transport->receive(buffer)) > 0) {
+        m_bytes += length;
+        decode(buffer, length);
+    }
+
+    ViewPacket packet;
+    packet.magic  = VIEW_MAGIC;
+    packet.acked  = m_latest;
+    packet.left   = view.left;
+    packet.right  = view.right;
+    packet.bottom = view.bottom;
+    packet.top    = view.top;
+    m_transport->send(&packet, sizeof(packet));
+}
+
+bool SnapshotClient::decode(const Uint8 *data, int length) {
+    BitReader reader(data, length);
+    if (reader.read(8) != SNAPSHOT_MAGIC) return false;
+
+    Snapshot snapshot;
+    snapshot.sequence = reader.read(SEQUENCE_BITS);
+    // Anything older than what we've got is no use
+    if (snapshot.sequence <= m_latest) return false;
+
+    const Snapshot *baseline = nullptr;
+    if (reader.read_bool()) {
+        Uint32 base_sequence = snapshot.sequence - reader.read(BASELINE_BITS);
+        baseline = &m_received[base_sequence % SnapshotServer::SENT_HISTORY];
+        if (baseline->sequence != base_sequence) return false;
+    }
+    snapshot.scene = (Uint8) reader.read(SCENE_BITS);
+    snapshot.lives = (Uint8) reader.read(LIVES_BITS);
+    int count = (int) reader.read(COUNT_BITS);
+
+    int previous_id = -1;
+    size_t base_index = 0;
+    for (int i = 0; i < count and not reader.has_overflowed(); i++) {
+        NetEntity entity;
+        entity.id = (Uint16) (reader.read_bool() ? previous_id + 1 : reader.read(ID_BITS));
+        previous_id = entity.id;
+
+        const NetEntity *base = nullptr;
+        if (baseline) {
+            while (base_index < baseline->entities.size() and baseline->entities[base_index].id < entity.id) base_index++;
+            if (base_index < baseline->entities.size() and baseline->entities[base_index].id == entity.id)
+                base = &baseline->entities[base_index];
+        }
+
+        if (base and not reader.read_bool()) {
+            snapshot.entities.push_back(*base);
+            continue;
+        }
+        entity.x = read_position(reader, base ? &base->x : nullptr);
+        entity.y = read_position(reader, base ? &base->y : nullptr);
+        bool new_animation = not base or reader.read_bool();
+        entity.animation_index = new_animation ? (Uint8) reader.read(ANIMATION_BITS) : base->animation_index;
+        entity.flags = (Uint8) reader.read(FLAG_BITS);
+        snapshot.entities.push_back(entity);
+    }
+    if (reader.has_overflowed()) return false;
+
+    m_latest = snapshot.sequence;
+    m_received[m_latest % SnapshotServer::SENT_HISTORY] = std::move(snapshot);
+    return true;
+}
+
+void SnapshotClient::apply(Scene *scene, int *lives) const {
+    if (not has_snapshot()) return;
+    const Snapshot &snapshot = get_latest();
+
+    size_t next = 0;
+    for (int id = 0; id < scene->get_indexed_count(); id++) {
+        Entity *entity = scene->get_indexed_entity(id);
+        if (next < snapshot.entities.size() and snapshot.entities[next].id == id) {
+            const NetEntity &net = snapshot.entities[next++];
+            entity->apply_replica(glm::vec3(net.x / POSITION_SCALE, net.y / POSITION_SCALE, 0.0f),
+                                  (net.flags & NET_FACING_RIGHT) != 0, net.animation_index);
+        }
+        else entity->deactivate();
+    }
+    scene->update_spatial_index();
+    *lives = snapshot.lives;
+}
@@ -0,0 +1,112 @@
+#ifndef SNAPSHOTSERVER_H
+#define SNAPSHOTSERVER_H
+
+#pragma once
+#include <SDL.h>
+#include <vector>
+#include "Network.hpp"
+#include "Scene.hpp"
+
+// An entity as a client sees it: position quantised to 1/64 of a unit, and just
+// enough else to draw it. The id is its index in the scene (see Scene::get_indexed_entity)
+struct NetEntity {
+    Uint16  id;
+    Sint32  x,
+            y;
+    Uint8   animation_index,
+            flags;              // NET_FACING_RIGHT
+};
+
+enum NetEntityFlags { NET_FACING_RIGHT = 1 };
+
+struct Snapshot {
+    Uint32  sequence = 0;       // 0 is never sent, so it can mean "none"
+    Uint8   scene = 0,
+            lives = 0;
+    std::vector<NetEntity> entities;    // by id; anything missing isn't in view
+};
+
+struct ClientStats {
+    int     packets = 0,
+            entities = 0;       // sent in total
+    size_t  bytes = 0;
+    float   total_encode_us = 0.0f,     // finding, building and packing this client's snapshots
+            peak_encode_us = 0.0f;
+};
+
+// Runs alongside the simulation and sends each client a snapshot of just the
+// entities near what it's looking at, found through the scene's spatial grid, so
+// what a client costs (in bytes and in server time) depends on how much it can
+// see rather than on the size of the level.
+//
+// Snapshots are bit-packed and delta-compressed against the last one the client
+// acknowledged: an entity that hasn't changed since then costs a couple of bits,
+// and one that has costs a few bytes. Anything the client hasn't acknowledged is
+// never used as a base, so lost packets don't need resending.
+//
+// Clients only send their acknowledgement and what they can see; the server is
+// the only one running the game.
+class SnapshotServer {
+public:
+    static constexpr int    SENT_HISTORY = 32,      // snapshots kept per client to diff against
+                            MAX_VIEW_ENTITIES = 48; // nearest first, if more are in view
+
+private:
+    struct Client {
+        Transport *transport;                   // owned
+        bool    has_view = false;
+        Bounds  view;
+        Uint32  next_sequence = 1,
+                acked = 0;
+        Snapshot sent[SENT_HISTORY];            // by sequence
+        ClientStats stats;
+    };
+
+    std::vector<Client*> m_clients;
+    std::vector<int> m_ids;                     // reused for grid queries
+
+    void receive(Client &client);
+    void send_snapshot(Client &client, Scene *scene, int scene_index, int lives);
+
+public:
+    ~SnapshotServer();
+
+    // Takes ownership of transport; returns the client's index
+    int add_client(Transport *transport);
+    int const get_client_count() const { return (int) m_clients.size(); }
+
+    // After each fixed step
+    void tick(Scene *scene, int scene_index, int lives);
+
+    ClientStats const get_stats(int client) const { return m_clients[client]->stats; }
+    // What was sent to client as sequence, while it's still kept (for checking clients)
+    const Snapshot *get_sent(int client, Uint32 sequence) const;
+};
+
+// The other end: tells the server what it can see, and keeps the latest snapshot
+// to put into a local copy of the scene
+class SnapshotClient {
+private:
+    Transport *m_transport;                     // owned
+    Snapshot m_received[SnapshotServer::SENT_HISTORY];  // by sequence, for the deltas
+    Uint32 m_latest = 0;
+    size_t m_bytes = 0;
+
+    bool decode(const Uint8 *data, int length);
+
+public:
+    SnapshotClient(Transport *transport) : m_transport(transport) { }
+    ~SnapshotClient() { delete m_transport; }
+
+    // Takes in whatever has arrived, then acknowledges it and sends the new view
+    void update(const Bounds &view);
+
+    bool const has_snapshot() const { return m_latest != 0; }
+    const Snapshot &get_latest() const { return m_received[m_latest % SnapshotServer::SENT_HISTORY]; }
+    size_t const get_bytes_received() const { return m_bytes; }
+
+    // Moves the scene's entities to the latest snapshot; ones it doesn't mention are hidden
+    void apply(Scene *scene, int *lives) const;
+};
+
+#endif // SNAPSHOTSERVER_H
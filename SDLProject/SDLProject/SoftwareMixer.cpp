@@ -0,0 +1,242 @@
+// SoftwareMixer.cpp
+#define LOG(argument) std::cout << argument << '\n'
+
+#include "SoftwareMixer.hpp"
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#if defined(__SSE__) or defined(_M_X64) or (defined(_M_IX86_FP) and _M_IX86_FP >= 1)
+    #include <xmmintrin.h>
+    #define MIXER_SSE 1
+#elif defined(__ARM_NEON) or defined(__ARM_NEON__)
+    #include <arm_neon.h>
+    #define MIXER_NEON 1
+#endif
+
+namespace {
+    class MixerSound : public Sound {
+    public:
+        std::vector<float> m_samples;   // interleaved stereo at the device rate
+        int m_frame_count;
+        MixerSound(std::vector<float> &&samples) :
+        m_samples(std::move(samples)), m_frame_count((int) m_samples.size() / 2) {}
+    };
+
+    /* ----- MIXING KERNELS ----- */
+    // Four floats at a time, then whatever is left one by one
+
+    // output += input * gain
+    void mix_into(float *output, const float *input, int count, float gain) {
+        int i = 0;
+#if MIXER_SSE
+        __m128 gains = _mm_set1_ps(gain);
+        for (; i + 4 <= count; i += 4)
+            _mm_storeu_ps(output + i, _mm_add_ps(_mm_loadu_ps(output + i),
+                                                 _mm_mul_ps(_mm_loadu_ps(input + i), gains)));
+#elif MIXER_NEON
+        for (; i + 4 <= count; i += 4)
+            vst1q_f32(output + i, vmlaq_n_f32(vld1q_f32(output + i), vld1q_f32(input + i), gain));
+#endif
+        for (; i < count; i++) output[i] += input[i] * gain;
+    }
+
+    // Hard clip to -1..1, so a pile of voices distorts instead of wrapping
+    void clip(float *output, int count) {
+        int i = 0;
+#if MIXER_SSE
+        __m128 low = _mm_set1_ps(-1.0f), high = _mm_set1_ps(1.0f);
+        for (; i + 4 <= count; i += 4)
+            _mm_storeu_ps(output + i, _mm_min_ps(high, _mm_max_ps(low, _mm_loadu_ps(output + i))));
+#elif MIXER_NEON
+        float32x4_t low = vdupq_n_f32(-1.0f), high = vdupq_n_f32(1.0f);
+        for (; i + 4 <= count; i += 4)
+            vst1q_f32(output + i, vminq_f32(high, vmaxq_f32(low, vld1q_f32(output + i))));
+#endif
+        for (; i < count; i++) {
+            if (output[i] > 1.0f) output[i] = 1.0f;
+            else if (output[i] < -1.0f) output[i] = -1.0f;
+        }
+    }
+}
+
+SoftwareMixerAudio::SoftwareMixerAudio(int frequency, int buffer_size) :
+m_frequency(frequency), m_buffer_size(buffer_size), m_music(frequency, CHANNELS, MUSIC_BUFFER_SIZE) {
+    for (int voice = 0; voice < MAX_VOICES; voice++) m_finished[voice] = 0;
+}
+
+bool SoftwareMixerAudio::open() {
+    // Music first; its device is separate from ours and nothing else plays on it
+    if (m_music.open()) m_music.set_voice_count(0);
+
+    SDL_AudioSpec desired, obtained;
+    SDL_zero(desired);
+    desired.freq        = m_frequency;
+    desired.format      = AUDIO_F32SYS;
+    desired.channels    = CHANNELS;
+    desired.samples     = (Uint16) m_buffer_size;
+    desired.callback    = audio_callback;
+    desired.userdata    = this;
+
+    // SDL converts for us if the device wants something else, so the callback
+    // can always mix float stereo; only the buffer size may differ
+    m_device = SDL_OpenAudioDevice(nullptr, 0, &desired, &obtained, SDL_AUDIO_ALLOW_SAMPLES_CHANGE);
+    if (m_device == 0) {
+        LOG("Unable to open audio: " << SDL_GetError());
+        return false;
+    }
+    m_buffer_size = obtained.samples;
+    LOG("Mixing " << CHANNELS << " channels at " << m_frequency << " Hz, " << m_buffer_size
+        << " frame buffers (" << (float) m_buffer_size * 1000.0f / m_frequency << " ms).");
+
+    SDL_PauseAudioDevice(m_device, 0);
+    return true;
+}
+
+void SoftwareMixerAudio::close() {
+    if (m_device != 0) {
+        SDL_CloseAudioDevice(m_device);
+        m_device = 0;
+
+        MixerStats stats = get_stats();
+        LOG("Mixer: " << stats.callbacks << " callbacks, " << stats.average_ms << " ms average, "
+            << stats.peak_ms << " ms peak of a " << stats.budget_ms << " ms budget, "
+            << stats.overruns << " overrun(s).");
+    }
+    m_music.close();
+}
+
+Sound *SoftwareMixerAudio::load_sound(const char *filepath) {
+    SDL_AudioSpec spec;
+    Uint8 *buffer;
+    Uint32 length;
+    if (SDL_LoadWAV(filepath, &spec, &buffer, &length) == nullptr) return nullptr;
+
+    // Everything up front, so mixing never has to convert
+    SDL_AudioCVT cvt;
+    if (SDL_BuildAudioCVT(&cvt, spec.format, spec.channels, spec.freq,
+                          AUDIO_F32SYS, CHANNELS, m_frequency) < 0) {
+        SDL_FreeWAV(buffer);
+        return nullptr;
+    }
+    std::vector<Uint8> converted(length * cvt.len_mult);
+    memcpy(converted.data(), buffer, length);
+    SDL_FreeWAV(buffer);
+
+    cvt.buf = converted.data();
+    cvt.len = (int) length;
+    if (cvt.needed and SDL_ConvertAudio(&cvt) < 0) return nullptr;
+    int converted_length = cvt.needed ? cvt.len_cvt : (int) length;
+
+    std::vector<float> samples(converted_length / sizeof(float));
+    memcpy(samples.data(), converted.data(), samples.size() * sizeof(float));
+    return new MixerSound(std::move(samples));
+}
+
+void SoftwareMixerAudio::free_sound(Sound *sound) {
+    if (not sound) return;
+    const float *samples = static_cast<MixerSound*>(sound)->m_samples.data();
+
+    // The callback may be halfway through it, so hold it off while we cut it loose.
+    // With the callback held off we're the only consumer, so take anything still
+    // queued as well, in case it's a play of this sound
+    if (m_device != 0) SDL_LockAudioDevice(m_device);
+    run_commands();
+    for (int voice = 0; voice < MAX_VOICES; voice++)
+        if (m_voices[voice].samples == samples) finish_voice(voice);
+    if (m_device != 0) SDL_UnlockAudioDevice(m_device);
+
+    delete sound;
+}
+
+void SoftwareMixerAudio::set_voice_count(int count) {
+    if (count > MAX_VOICES) {
+        LOG("The mixer only has " << MAX_VOICES << " voices, not " << count << ".");
+        count = MAX_VOICES;
+    }
+    m_voice_count = count;
+}
+
+void SoftwareMixerAudio::play_sound(Sound *sound, int voice, float volume) {
+    if (not sound or voice < 0 or voice >= m_voice_count) return;
+
+    // Only counts as playing once it's actually queued
+    Uint32 sequence = m_requested[voice] + 1;
+    if (m_commands.push({ PLAY_VOICE, voice, sound, volume, sequence }))
+        m_requested[voice] = sequence;
+}
+
+void SoftwareMixerAudio::stop_voice(int voice) {
+    if (voice < 0 or voice >= m_voice_count) return;
+    m_commands.push({ STOP_VOICE, voice, nullptr, 0.0f, m_requested[voice] });
+}
+
+bool const SoftwareMixerAudio::is_voice_playing(int voice) const {
+    if (voice < 0 or voice >= m_voice_count) return false;
+    return m_finished[voice].load(std::memory_order_acquire) != m_requested[voice];
+}
+
+MixerStats SoftwareMixerAudio::get_stats() const {
+    MixerStats stats;
+    float ticks_to_ms = 1000.0f / (float) SDL_GetPerformanceFrequency();
+    stats.callbacks = m_callbacks.load();
+    stats.overruns  = m_overruns.load();
+    stats.peak_ms   = (float) m_peak_ticks.load() * ticks_to_ms;
+    stats.budget_ms = (float) m_buffer_size * 1000.0f / (float) m_frequency;
+    if (stats.callbacks > 0)
+        stats.average_ms = (float) m_total_ticks.load() * ticks_to_ms / (float) stats.callbacks;
+    return stats;
+}
+
+void SoftwareMixerAudio::finish_voice(int voice) {
+    m_voices[voice].samples = nullptr;
+    m_finished[voice].store(m_voices[voice].sequence, std::memory_order_release);
+}
+
+void SoftwareMixerAudio::audio_callback(void *userdata, Uint8 *stream, int length) {
+    SoftwareMixerAudio *mixer = static_cast<SoftwareMixerAudio*>(userdata);
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    mixer->mix((float *) stream, length / (int) (sizeof(float) * CHANNELS));
+
+    Uint64 elapsed = SDL_GetPerformanceCounter() - start,
+           budget  = (Uint64) mixer->m_buffer_size * SDL_GetPerformanceFrequency() / mixer->m_frequency;
+    mixer->m_callbacks++;
+    mixer->m_total_ticks += elapsed;
+    if (elapsed > mixer->m_peak_ticks.load()) mixer->m_peak_ticks = elapsed;
+    if (elapsed > budget) mixer->m_overruns++;
+}
+
+void SoftwareMixerAudio::run_commands() {
+    Command command;
+    while (m_commands.pop(command)) {
+        Voice &voice = m_voices[command.voice];
+        if (command.type == STOP_VOICE) {
+            if (voice.sequence == command.sequence) finish_voice(command.voice);
+            continue;
+        }
+        MixerSound *sound = static_cast<MixerSound*>(command.sound);
+        voice.samples       = sound->m_samples.data();
+        voice.frame_count   = sound->m_frame_count;
+        voice.position      = 0;
+        voice.volume        = command.volume;
+        voice.sequence      = command.sequence;
+    }
+}
+
+void SoftwareMixerAudio::mix(float *output, int frame_count) {
+    run_commands();
+
+    memset(output, 0, frame_count * CHANNELS * sizeof(float));
+    for (int index = 0; index < m_voice_count; index++) {
+        Voice &voice = m_voices[index];
+        if (voice.samples == nullptr) continue;
+
+        int frames = std::min(frame_count, voice.frame_count - voice.position);
+        mix_into(output, voice.samples + voice.position * CHANNELS, frames * CHANNELS, voice.volume);
+        voice.position += frames;
+        if (voice.position >= voice.frame_count) finish_voice(index);
+    }
+    clip(output, frame_count * CHANNELS);
+}
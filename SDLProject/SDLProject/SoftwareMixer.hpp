@@ -0,0 +1,104 @@
+#ifndef SOFTWAREMIXER_H
+#define SOFTWAREMIXER_H
+
+#pragma once
+#include <SDL.h>
+#include <atomic>
+#include "Audio.hpp"
+#include "SPSCQueue.hpp"
+
+struct MixerStats {
+    int     callbacks   = 0,
+            overruns    = 0;        // callbacks that took longer than the buffer lasts
+    float   average_ms  = 0.0f,
+            peak_ms     = 0.0f,
+            budget_ms   = 0.0f;     // how long one buffer plays for
+};
+
+// Mixes sound effects itself, in an SDL_AudioSpec callback, instead of handing them
+// to SDL_mixer's channels. Sounds are converted to float stereo at the device rate
+// when they're loaded, so the callback only has to scale and add (with SSE or NEON
+// where we have it), which keeps it cheap enough for 256-512 frame buffers.
+// The game never touches the voices directly: play/stop go through a lock-free
+// queue the callback drains at the start of each buffer.
+//
+// Music isn't latency sensitive and needs SDL_mixer's decoders, so it stays on a
+// MixerAudio with its own device and a big buffer.
+//
+// SDL_AUDIODRIVER=dummy runs all of this (callback timing included) with no sound card.
+class SoftwareMixerAudio : public Audio {
+public:
+    static constexpr int MAX_VOICES = 32;
+
+private:
+    static constexpr int    COMMAND_QUEUE_SIZE  = 256,
+                            MUSIC_BUFFER_SIZE   = 4096,
+                            CHANNELS            = 2;
+
+    enum CommandType { PLAY_VOICE, STOP_VOICE };
+
+    struct Command {
+        CommandType type;
+        int     voice;
+        Sound   *sound;
+        float   volume;
+        Uint32  sequence;
+    };
+
+    // Audio thread only, apart from free_sound (which locks the device)
+    struct Voice {
+        const float *samples = nullptr;     // interleaved stereo
+        int     frame_count = 0,
+                position    = 0;
+        float   volume      = 1.0f;
+        Uint32  sequence    = 0;
+    };
+
+    int m_frequency,
+        m_buffer_size,
+        m_voice_count = MAX_VOICES;
+
+    SDL_AudioDeviceID m_device = 0;
+    MixerAudio m_music;
+
+    SPSCQueue<Command, COMMAND_QUEUE_SIZE> m_commands;
+    Voice m_voices[MAX_VOICES];
+
+    // A voice is busy until the callback has finished the last play queued on it
+    Uint32 m_requested[MAX_VOICES] = { 0 };             // game side
+    std::atomic<Uint32> m_finished[MAX_VOICES];         // audio side
+
+    // Written by the callback, read by get_stats
+    std::atomic<int>    m_callbacks { 0 },
+                        m_overruns  { 0 };
+    std::atomic<Uint64> m_total_ticks { 0 },
+                        m_peak_ticks  { 0 };
+
+    static void audio_callback(void *userdata, Uint8 *stream, int length);
+    void run_commands();
+    void mix(float *output, int frame_count);
+    void finish_voice(int voice);
+
+public:
+    SoftwareMixerAudio(int frequency, int buffer_size);
+
+    bool open() override;
+    void close() override;
+
+    Sound *load_sound(const char *filepath) override;
+    Music *load_music(const char *filepath) override { return m_music.load_music(filepath); }
+    void free_sound(Sound *sound) override;
+    void free_music(Music *music) override { m_music.free_music(music); }
+
+    void set_voice_count(int count) override;
+    void play_sound(Sound *sound, int voice, float volume) override;
+    void stop_voice(int voice) override;
+    bool const is_voice_playing(int voice) const override;
+
+    void play_music(Music *music, int loops) override { m_music.play_music(music, loops); }
+    void set_music_volume(float volume) override { m_music.set_music_volume(volume); }
+
+    MixerStats get_stats() const;
+};
+
+#endif // SOFTWAREMIXER_H
@@ -0,0 +1,103 @@
+// SpatialGrid.cpp
+#include "SpatialGrid.hpp"
+#include <algorithm>
+#include <cmath>
+
+SpatialGrid::SpatialGrid(const Bounds &world, float cell_size) {
+    reset(world, cell_size);
+}
+
+void SpatialGrid::reset(const Bounds &world, float cell_size) {
+    m_world     = world;
+    m_cell_size = cell_size;
+    m_columns   = std::max(1, (int) std::ceil((world.right - world.left) / cell_size));
+    m_rows      = std::max(1, (int) std::ceil((world.top - world.bottom) / cell_size));
+
+    m_cells.assign(m_columns * m_rows, std::vector<int>());
+    m_ranges.clear();
+    m_in_grid.clear();
+    m_query_stamps.clear();
+    m_query_stamp = 0;
+}
+
+SpatialGrid::CellRange const SpatialGrid::get_range(const Bounds &bounds) const {
+    auto column = [this](float x) {
+        return std::min(m_columns - 1, std::max(0, (int) std::floor((x - m_world.left) / m_cell_size)));
+    };
+    auto row = [this](float y) {
+        return std::min(m_rows - 1, std::max(0, (int) std::floor((y - m_world.bottom) / m_cell_size)));
+    };
+    return { column(bounds.left), row(bounds.bottom), column(bounds.right), row(bounds.top) };
+}
+
+void SpatialGrid::add_to_cells(int id, const CellRange &range) {
+    for (int y = range.min_y; y <= range.max_y; y++)
+        for (int x = range.min_x; x <= range.max_x; x++)
+            m_cells[y * m_columns + x].push_back(id);
+}
+
+void SpatialGrid::remove_from_cells(int id, const CellRange &range) {
+    for (int y = range.min_y; y <= range.max_y; y++) {
+        for (int x = range.min_x; x <= range.max_x; x++) {
+            std::vector<int> &cell = m_cells[y * m_columns + x];
+            // Cells only hold a handful of ids, and order within one doesn't matter
+            auto found = std::find(cell.begin(), cell.end(), id);
+            if (found != cell.end()) {
+                *found = cell.back();
+                cell.pop_back();
+            }
+        }
+    }
+}
+
+void SpatialGrid::insert(int id, const Bounds &bounds) {
+    if (id >= (int) m_ranges.size()) {
+        m_ranges.resize(id + 1);
+        m_in_grid.resize(id + 1, false);
+        m_query_stamps.resize(id + 1, 0);
+    }
+    if (m_in_grid[id]) remove_from_cells(id, m_ranges[id]);
+
+    m_ranges[id]  = get_range(bounds);
+    m_in_grid[id] = true;
+    add_to_cells(id, m_ranges[id]);
+}
+
+void SpatialGrid::move(int id, const Bounds &bounds) {
+    if (id >= (int) m_ranges.size() or not m_in_grid[id]) {
+        insert(id, bounds);
+        return;
+    }
+
+    CellRange range = get_range(bounds);
+    const CellRange &old = m_ranges[id];
+    if (range.min_x == old.min_x and range.min_y == old.min_y and
+        range.max_x == old.max_x and range.max_y == old.max_y) return;
+
+    remove_from_cells(id, old);
+    m_ranges[id] = range;
+    add_to_cells(id, range);
+}
+
+void SpatialGrid::remove(int id) {
+    if (id >= (int) m_ranges.size() or not m_in_grid[id]) return;
+    remove_from_cells(id, m_ranges[id]);
+    m_in_grid[id] = false;
+}
+
+void SpatialGrid::query(const Bounds &bounds, std::vector<int> &out) {
+    m_query_stamp++;
+    size_t first = out.size();
+
+    CellRange range = get_range(bounds);
+    for (int y = range.min_y; y <= range.max_y; y++) {
+        for (int x = range.min_x; x <= range.max_x; x++) {
+            for (int id : m_cells[y * m_columns + x]) {
+                if (m_query_stamps[id] == m_query_stamp) continue;
+                m_query_stamps[id] = m_query_stamp;
+                out.push_back(id);
+            }
+        }
+    }
+    std::sort(out.begin() + first, out.end());
+}
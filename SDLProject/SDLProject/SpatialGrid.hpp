@@ -0,0 +1,58 @@
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#pragma once
+#include <vector>
+
+// An axis-aligned rectangle in world units
+struct Bounds {
+    float left, right, bottom, top;
+
+    bool const overlaps(const Bounds &other) const {
+        return left <= other.right and right >= other.left and
+               bottom <= other.top and top >= other.bottom;
+    }
+};
+
+// Uniform grid over a fixed world area that buckets ids by the cells their bounds
+// touch, so asking "what's in this rectangle" only looks at the cells it covers
+// rather than every entity. Anything outside the world gets clamped into the
+// border cells, so it's still found, just less efficiently.
+class SpatialGrid {
+private:
+    struct CellRange { int min_x, min_y, max_x, max_y; };
+
+    Bounds m_world;
+    float  m_cell_size;
+    int    m_columns,
+           m_rows;
+
+    std::vector<std::vector<int>> m_cells;
+    std::vector<CellRange> m_ranges;        // by id, where each one is currently filed
+    std::vector<bool>      m_in_grid;
+    std::vector<int>       m_query_stamps;  // so an id spanning several cells is only returned once
+    int m_query_stamp = 0;
+
+    CellRange const get_range(const Bounds &bounds) const;
+    void add_to_cells(int id, const CellRange &range);
+    void remove_from_cells(int id, const CellRange &range);
+
+public:
+    SpatialGrid(const Bounds &world = { 0.0f, 1.0f, -1.0f, 0.0f }, float cell_size = 4.0f);
+
+    // Empties the grid and resizes it to cover a new world
+    void reset(const Bounds &world, float cell_size);
+
+    void insert(int id, const Bounds &bounds);
+    // Cheap when the bounds are still in the same cells, which is most frames
+    void move(int id, const Bounds &bounds);
+    void remove(int id);
+
+    // Appends the ids whose cells overlap bounds, in ascending order; callers
+    // still need to test the exact bounds
+    void query(const Bounds &bounds, std::vector<int> &out);
+
+    int const get_cell_count() const { return m_columns * m_rows; }
+};
+
+#endif // SPATIALGRID_H
@@ -15,11 +15,27 @@ unsigned int START_LEVEL_DATA[] = {
     121, 122, 122, 122, 122, 122, 122, 122, 122, 122, 122, 122, 122, 123
 };
 
+namespace {
+    // Walks to the wall, gets its breath back, then hops round and heads the other way
+    Script pace(ScriptScheduler &scripts, Entity *alien) {
+        while (true) {
+            if (alien->get_facing_right()) alien->move_right();
+            else alien->move_left();
+            co_await scripts.until(alien, EVENT_WALL | EVENT_LEDGE);
+            
+            alien->set_mov(vec3(0.0f));
+            co_await scripts.wait(2.0f);
+            
+            alien->jump();
+            if (alien->get_facing_right()) alien->move_left();
+            else alien->move_right();
+        }
+    }
+}
+
 Start::~Start() {
     delete    m_game_state.player;
     delete    m_game_state.map;
-    Mix_FreeChunk(m_game_state.jump_sfx);
-    Mix_FreeMusic(m_game_state.bgm);
 }
 
 void Start::initialise() {
@@ -35,30 +51,21 @@ void Start::initialise() {
                                       4.0f,       // jumping power
                                       player_walking_anim,
                                       1.0f,        // size
-                                      ENEMY, WALKER, IDLE));
+                                      ENEMY, SCRIPTED, IDLE));
     m_game_state.enemies[0]->update(m_game_state.map, 0.0f);
     m_game_state.enemies[0]->set_pos(glm::vec3(2.0f, 0.0f, 0.0f));
     m_game_state.player = m_game_state.enemies[0];
-
-
-    Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 4096);
-    
-//    m_game_state.bgm = Mix_LoadMUS(BGM_FILEPATH);
-//    Mix_PlayMusic(m_game_state.bgm, -1);
-//    Mix_VolumeMusic(0.0f);
     
-    m_game_state.jump_sfx = Mix_LoadWAV(JUMP_SFX_FILEPATH);
+    m_scripts.spawn([this] { return pace(m_scripts, m_game_state.player); });
 }
 
 void Start::update(float delta_time) {
     m_game_state.enemies[0]->update(m_game_state.map, delta_time, m_game_state.player);
+    m_scripts.tick(delta_time);
 }
 
 
-void Start::render(ShaderProgram *g_shader_program) {
-    m_game_state.map->render(g_shader_program);
-    m_game_state.enemies[0]->render(g_shader_program);
-    
+void Start::render_hud(ShaderProgram *g_shader_program) {
     Utility::draw_text(g_shader_program, g_font_texture_id, "Green Alien Game",
                       0.35f, 0.001f, vec3(2.8f, -2.9f, 0.0f));
     Utility::draw_text(g_shader_program, g_font_texture_id, "Hit Enter to Start!",
@@ -11,7 +11,7 @@ public:
     
     void initialise() override;
     void update(float delta_time) override;
-    void render(ShaderProgram *program) override;
+    void render_hud(ShaderProgram *program) override;
 };
 
 #endif // LEVEL1_H
@@ -0,0 +1,127 @@
+// StateHistory.cpp
+#define LOG(argument) std::cout << argument << '\n'
+
+#include "StateHistory.hpp"
+#include <algorithm>
+#include <iostream>
+
+constexpr float MICROSECONDS_IN_SECOND = 1000000.0f;
+
+namespace {
+    void put_varint(std::vector<Uint8> &out, size_t value) {
+        do {
+            Uint8 byte = value & 0x7f;
+            value >>= 7;
+            out.push_back(value > 0 ? byte | 0x80 : byte);
+        } while (value > 0);
+    }
+
+    size_t get_varint(const std::vector<Uint8> &in, size_t &offset) {
+        size_t value = 0;
+        int shift = 0;
+        while (offset < in.size()) {
+            Uint8 byte = in[offset++];
+            value |= (size_t) (byte & 0x7f) << shift;
+            shift += 7;
+            if (not (byte & 0x80)) break;
+        }
+        return value;
+    }
+}
+
+void StateHistory::set_capacity(int frames) {
+    m_deltas.assign(std::max(frames, 1), std::vector<Uint8>());
+    clear();
+}
+
+void StateHistory::clear() {
+    m_latest.clear();
+    m_head = 0;
+    m_count = 0;
+    m_delta_bytes = 0;
+}
+
+// A run of unchanged bytes, then a run of changed ones (as from ^ to), repeated
+void StateHistory::encode_delta(const std::vector<Uint8> &from, const std::vector<Uint8> &to,
+                                std::vector<Uint8> &delta) {
+    delta.clear();
+    size_t i = 0, size = to.size();
+    while (i < size) {
+        size_t same_start = i;
+        while (i < size and from[i] == to[i]) i++;
+        if (i == size) break;
+
+        size_t changed_start = i;
+        while (i < size and from[i] != to[i]) i++;
+
+        put_varint(delta, changed_start - same_start);
+        put_varint(delta, i - changed_start);
+        for (size_t j = changed_start; j < i; j++) delta.push_back(from[j] ^ to[j]);
+    }
+}
+
+void StateHistory::apply_delta(const std::vector<Uint8> &delta, std::vector<Uint8> &state) {
+    size_t offset = 0, position = 0;
+    while (offset < delta.size()) {
+        position += get_varint(delta, offset);
+        size_t changed = get_varint(delta, offset);
+        for (size_t j = 0; j < changed and position < state.size(); j++)
+            state[position++] ^= delta[offset++];
+    }
+}
+
+void StateHistory::push(const std::vector<Uint8> &state) {
+    if (m_deltas.empty()) set_capacity(1);
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    if (m_latest.size() != state.size()) {
+        // Nothing to diff against; this is where the history starts
+        clear();
+        m_latest = state;
+        return;
+    }
+
+    if (m_count == (int) m_deltas.size()) {
+        // The oldest one goes; it's the slot we're about to write
+        m_delta_bytes -= m_deltas[m_head].size();
+        m_count--;
+    }
+
+    std::vector<Uint8> &delta = m_deltas[m_head];
+    encode_delta(state, m_latest, delta);
+    m_head = (m_head + 1) % m_deltas.size();
+    m_count++;
+    m_delta_bytes += delta.size();
+    m_latest = state;
+
+    Uint64 ticks = SDL_GetPerformanceCounter() - start;
+    m_pushes++;
+    m_pushed_bytes += delta.size();
+    m_push_ticks += ticks;
+    m_peak_push_ticks = std::max(m_peak_push_ticks, ticks);
+}
+
+int StateHistory::rewind(int frames, std::vector<Uint8> &state) {
+    int steps = std::min(frames, m_count);
+    for (int i = 0; i < steps; i++) {
+        m_head = (m_head + (int) m_deltas.size() - 1) % m_deltas.size();
+        apply_delta(m_deltas[m_head], m_latest);
+        m_delta_bytes -= m_deltas[m_head].size();
+        m_count--;
+    }
+    state = m_latest;
+    return steps;
+}
+
+HistoryStats StateHistory::get_stats() const {
+    HistoryStats stats;
+    stats.frames         = m_count;
+    stats.resident_bytes = m_delta_bytes + m_latest.size();
+    if (m_pushes == 0) return stats;
+
+    float ticks_to_us = MICROSECONDS_IN_SECOND / (float) SDL_GetPerformanceFrequency();
+    stats.average_delta_bytes = (float) m_pushed_bytes / m_pushes;
+    stats.average_push_us     = (float) m_push_ticks / m_pushes * ticks_to_us;
+    stats.peak_push_us        = (float) m_peak_push_ticks * ticks_to_us;
+    return stats;
+}
@@ -0,0 +1,55 @@
+#ifndef STATEHISTORY_H
+#define STATEHISTORY_H
+
+#pragma once
+#include <SDL.h>
+#include <vector>
+
+struct HistoryStats {
+    int     frames              = 0;    // held right now
+    size_t  resident_bytes      = 0;    // all the deltas plus the latest state
+    float   average_delta_bytes = 0.0f,
+            average_push_us     = 0.0f,
+            peak_push_us        = 0.0f;
+};
+
+// The last few seconds of a scene's state (see Scene::save_state), one per fixed
+// step, for rewinding. Only the newest state is kept whole; every step before it is
+// the XOR of it with the step after, run-length encoded. Most of a scene doesn't
+// move on a given step, so that's mostly zeros and a step costs tens of bytes.
+// XOR undoes itself, so rewinding is applying the newest deltas to the latest
+// state in turn, and dropping the oldest one when the buffer is full costs nothing.
+class StateHistory {
+private:
+    std::vector<Uint8> m_latest;
+    std::vector<std::vector<Uint8>> m_deltas;   // ring; the buffers are reused
+    int m_head  = 0,                            // where the next delta goes
+        m_count = 0;
+    size_t m_delta_bytes = 0;                   // currently held
+
+    // Lifetime totals, for get_stats
+    int    m_pushes = 0;
+    size_t m_pushed_bytes = 0;
+    Uint64 m_push_ticks = 0,
+           m_peak_push_ticks = 0;
+
+    static void encode_delta(const std::vector<Uint8> &from, const std::vector<Uint8> &to,
+                             std::vector<Uint8> &delta);
+    static void apply_delta(const std::vector<Uint8> &delta, std::vector<Uint8> &state);
+
+public:
+    // How many steps back it can go; clears the history
+    void set_capacity(int frames);
+    // For a new scene: a state can only be diffed against one from the same scene
+    void clear();
+
+    void push(const std::vector<Uint8> &state);
+    // Goes back up to frames steps, forgetting the ones after. Writes the state it
+    // lands on into state and returns how many steps it went back (0 once it runs out)
+    int rewind(int frames, std::vector<Uint8> &state);
+
+    int const get_count() const { return m_count; }
+    HistoryStats get_stats() const;
+};
+
+#endif // STATEHISTORY_H
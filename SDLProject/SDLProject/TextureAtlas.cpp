@@ -0,0 +1,76 @@
+// TextureAtlas.cpp
+#include "TextureAtlas.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    constexpr int BYTES_PER_PIXEL = 4;
+
+    bool pack_into(const std::vector<TextureAtlas::Image> &images, const std::vector<int> &order,
+                   int page_size, std::vector<TextureAtlas::Rect> &rects) {
+        int x = 0, y = 0, shelf_height = 0;
+        for (int index : order) {
+            // Nothing to place (see compose)
+            if (images[index].width <= 0 or images[index].height <= 0) continue;
+            int width  = images[index].width  + 2 * TextureAtlas::PADDING,
+                height = images[index].height + 2 * TextureAtlas::PADDING;
+
+            // Start a new shelf when this one is full
+            if (x + width > page_size) {
+                x = 0;
+                y += shelf_height;
+                shelf_height = 0;
+            }
+            if (width > page_size or y + height > page_size) return false;
+
+            rects[index] = { x + TextureAtlas::PADDING, y + TextureAtlas::PADDING,
+                             images[index].width, images[index].height };
+            x += width;
+            shelf_height = std::max(shelf_height, height);
+        }
+        return true;
+    }
+}
+
+bool TextureAtlas::pack(const std::vector<Image> &images, std::vector<Rect> &rects, int *page_size) {
+    rects.assign(images.size(), Rect());
+
+    // Tallest first keeps the shelves tight
+    std::vector<int> order;
+    for (int i = 0; i < (int) images.size(); i++) order.push_back(i);
+    std::sort(order.begin(), order.end(), [&images](int a, int b) {
+        return images[a].height > images[b].height;
+    });
+
+    for (int size = MIN_PAGE_SIZE; size <= MAX_PAGE_SIZE; size *= 2) {
+        if (pack_into(images, order, size, rects)) {
+            *page_size = size;
+            return true;
+        }
+    }
+    return false;
+}
+
+unsigned char *TextureAtlas::compose(const std::vector<Image> &images, const std::vector<Rect> &rects,
+                                     int page_size) {
+    unsigned char *page = new unsigned char[page_size * page_size * BYTES_PER_PIXEL];
+    memset(page, 0, page_size * page_size * BYTES_PER_PIXEL);
+
+    for (int i = 0; i < (int) images.size(); i++) {
+        const Image &image = images[i];
+        const Rect  &rect  = rects[i];
+        if (not image.pixels or image.width <= 0 or image.height <= 0) continue;
+
+        // Every destination pixel in the padded rect reads the nearest source pixel
+        for (int y = -PADDING; y < image.height + PADDING; y++) {
+            int source_y = std::min(image.height - 1, std::max(0, y));
+            for (int x = -PADDING; x < image.width + PADDING; x++) {
+                int source_x = std::min(image.width - 1, std::max(0, x));
+                memcpy(&page[((rect.y + y) * page_size + rect.x + x) * BYTES_PER_PIXEL],
+                       &image.pixels[(source_y * image.width + source_x) * BYTES_PER_PIXEL],
+                       BYTES_PER_PIXEL);
+            }
+        }
+    }
+    return page;
+}
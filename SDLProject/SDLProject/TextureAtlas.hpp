@@ -0,0 +1,35 @@
+#ifndef TEXTUREATLAS_H
+#define TEXTUREATLAS_H
+
+#pragma once
+#include <string>
+#include <vector>
+
+// Packs several decoded RGBA images into one page so everything drawn from them
+// shares a single texture. Pure CPU work, so it runs on the loader's workers.
+class TextureAtlas {
+public:
+    static constexpr int PADDING        = 2,    // edge pixels repeated around each image
+                         MIN_PAGE_SIZE  = 256,
+                         MAX_PAGE_SIZE  = 4096;
+
+    struct Image {
+        std::string name;
+        int width, height;
+        const unsigned char *pixels;
+    };
+
+    // Where an image ended up, in pixels
+    struct Rect { int x, y, width, height; };
+
+    // Shelf-packs the images into the smallest power-of-two square page that fits.
+    // Returns false if they don't fit in MAX_PAGE_SIZE
+    static bool pack(const std::vector<Image> &images, std::vector<Rect> &rects, int *page_size);
+
+    // Copies the images into a new page (free with delete[]), extruding their
+    // edges into the padding so scaled or filtered sampling can't bleed
+    static unsigned char *compose(const std::vector<Image> &images, const std::vector<Rect> &rects,
+                                  int page_size);
+};
+
+#endif // TEXTUREATLAS_H
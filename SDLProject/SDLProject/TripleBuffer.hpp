@@ -0,0 +1,42 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#pragma once
+#include <atomic>
+
+// Hands values from one writer thread to one reader thread without either ever
+// waiting on the other. The writer fills its back slot and publishes it; the
+// reader picks up whatever was published last and keeps reading it until a newer
+// one arrives. The three slots just rotate, so nothing is copied or allocated
+// after construction, and a slow reader only ever skips values.
+template <typename T>
+class TripleBuffer {
+private:
+    static constexpr int FRESH      = 4,    // set on m_middle when the writer published since the last read
+                         INDEX_MASK = 3;
+
+    T m_slots[3];
+
+    int m_back  = 0,                        // writer only
+        m_front = 2;                        // reader only
+    std::atomic<int> m_middle { 1 };
+
+public:
+    // Writer: the slot to fill in before the next publish()
+    T &write_slot() { return m_slots[m_back]; }
+
+    void publish() {
+        m_back = m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // Reader: moves to the newest published value, if there is one; true if it moved
+    bool update() {
+        if (not (m_middle.load(std::memory_order_relaxed) & FRESH)) return false;
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    const T &read() const { return m_slots[m_front]; }
+};
+
+#endif // TRIPLEBUFFER_H
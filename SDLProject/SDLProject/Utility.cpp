@@ -1,23 +1,30 @@
 // Utility.cpp
 #define LOG(argument) std::cout << argument << '\n'
 #define STB_IMAGE_IMPLEMENTATION
-#define NUMBER_OF_TEXTURES 1
-#define LEVEL_OF_DETAIL 0
-#define TEXTURE_BORDER 0
 #define FONTBANK_SIZE 16
 
 #include "Utility.hpp"
-#include <SDL_image.h>
+#include "Renderer.hpp"
 #include "stb_image.h"
 
 
 void Utility::draw_text(ShaderProgram *shader_program, GLuint font_texture_id,
                         std::string text,
                         float font_size, float spacing, glm::vec3 position) {
+    if (text.empty()) return;
+    
+    // Skip building the mesh at all if none of it would be on screen
+    float half_size = font_size / 2.0f;
+    Bounds text_bounds = { position.x - half_size,
+                           position.x + (font_size + spacing) * (text.size() - 1) + half_size,
+                           position.y - half_size, position.y + half_size };
+    if (not Renderer::get()->is_visible(text_bounds)) return;
+    
     // Scale the size of the fontbank in the UV-plane
     // We will use this for spacing and positioning
-    float width = 1.0f / FONTBANK_SIZE;
-    float height = 1.0f / FONTBANK_SIZE;
+    TextureRegion region = Renderer::get()->get_region(font_texture_id);
+    float width = region.width / FONTBANK_SIZE;
+    float height = region.height / FONTBANK_SIZE;
 
     // Instead of having a single pair of arrays, we'll have a series of pairs—one for
     // each character. Don't forget to include <vector>!
@@ -32,8 +39,9 @@ void Utility::draw_text(ShaderProgram *shader_program, GLuint font_texture_id,
         float offset = (font_size + spacing) * i;
 
         // 2. Using the spritesheet index, we can calculate our U- and V-coordinates
-        float u_coordinate = (float) (spritesheet_index % FONTBANK_SIZE) / FONTBANK_SIZE;
-        float v_coordinate = (float) (spritesheet_index / FONTBANK_SIZE) / FONTBANK_SIZE;
+        //    (inside the font's part of the atlas, if it's in one)
+        float u_coordinate = region.map_u((float) (spritesheet_index % FONTBANK_SIZE) / FONTBANK_SIZE);
+        float v_coordinate = region.map_v((float) (spritesheet_index / FONTBANK_SIZE) / FONTBANK_SIZE);
 
         // 3. Inset the current pair in both vectors
         vertices.insert(vertices.end(), {
@@ -59,50 +67,38 @@ void Utility::draw_text(ShaderProgram *shader_program, GLuint font_texture_id,
     glm::mat4 model_matrix = glm::mat4(1.0f);
     model_matrix = translate(model_matrix, position);
 
-    shader_program->SetModelMatrix(model_matrix);
-    glUseProgram(shader_program->programID);
-
-    glVertexAttribPointer(shader_program->positionAttribute, 2, GL_FLOAT, false, 0,
-                          vertices.data());
-    glEnableVertexAttribArray(shader_program->positionAttribute);
-
-    glVertexAttribPointer(shader_program->texCoordAttribute, 2, GL_FLOAT,
-                          false, 0, texture_coordinates.data());
-    glEnableVertexAttribArray(shader_program->texCoordAttribute);
-
-    glBindTexture(GL_TEXTURE_2D, font_texture_id);
-    glDrawArrays(GL_TRIANGLES, 0, (int) (text.size() * 6));
-
-    glDisableVertexAttribArray(shader_program->positionAttribute);
-    glDisableVertexAttribArray(shader_program->texCoordAttribute);
+    Renderer::get()->draw_triangles(shader_program, font_texture_id, model_matrix,
+                                    vertices.data(), texture_coordinates.data(),
+                                    (int) (text.size() * 6), LAYER_HUD);
 }
 
 
 GLuint Utility::load_texture(const char* filepath) {
-    int width, height, number_of_components;
-    unsigned char* image = stbi_load(filepath, &width, &height, &number_of_components,
-                                     STBI_rgb_alpha);
+    int width, height;
+    unsigned char* image = decode_texture(filepath, &width, &height);
 
     if (not image) {
         LOG("Unable to load image. Make sure the path is correct.");
         assert(false);
     }
 
-    GLuint textureID;
-    glGenTextures(NUMBER_OF_TEXTURES, &textureID);
-
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glTexImage2D(GL_TEXTURE_2D, LEVEL_OF_DETAIL, GL_RGBA, width, height, TEXTURE_BORDER,
-                 GL_RGBA, GL_UNSIGNED_BYTE, image);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    GLuint textureID = upload_texture(image, width, height);
 
     stbi_image_free(image);
 
     return textureID;
 }
 
+unsigned char* Utility::decode_texture(const char* filepath, int *width, int *height) {
+    // Only touches the CPU, so this is safe to call from the loader's worker threads
+    int number_of_components;
+    return stbi_load(filepath, width, height, &number_of_components, STBI_rgb_alpha);
+}
 
+void Utility::free_texture_pixels(unsigned char* pixels) {
+    stbi_image_free(pixels);
+}
+
+GLuint Utility::upload_texture(const unsigned char* pixels, int width, int height) {
+    return Renderer::get()->upload_texture(pixels, width, height);
+}
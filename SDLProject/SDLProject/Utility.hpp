@@ -20,6 +20,10 @@
 class Utility {
 public:
     static GLuint load_texture(const char* filepath);
+    // load_texture split in two, so decoding can happen off the main thread
+    static unsigned char* decode_texture(const char* filepath, int *width, int *height);
+    static void free_texture_pixels(unsigned char* pixels);
+    static GLuint upload_texture(const unsigned char* pixels, int width, int height);
     static void draw_text(ShaderProgram *program, GLuint font_texture_id, std::string text, float font_size, float spacing, glm::vec3 position);
 };
 
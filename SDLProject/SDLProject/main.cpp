@@ -19,25 +19,43 @@
 
 #include <SDL.h>
 #include <SDL_opengl.h>
-#include <SDL_mixer.h>
 #include "glm/mat4x4.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #include "ShaderProgram.h"
 #include <vector>
 #include <ctime>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
 #include "cmath"
 
-#define NUMBER_OF_SCENES 4
+#define START_SCENE 0
 #define LEFT_EDGE 5.0f
 
 #include "Utility.hpp"
+#include "Renderer.hpp"
+#include "Audio.hpp"
+#include "AudioManager.hpp"
+#include "SoftwareMixer.hpp"
+#include "AssetLoader.hpp"
 #include "Scene.hpp"
 #include "Level1.hpp"
 #include "Level2.hpp"
 #include "Level3.hpp"
 #include "Start.hpp"
-
-#define FIXED_TIMESTEP 0.0166666f
+#include "SceneRegistry.hpp"
+#include "Profiler.hpp"
+#include "PerfOverlay.hpp"
+#include "FramePacer.hpp"
+#include "TripleBuffer.hpp"
+#include "InputQueue.hpp"
+#include "Replay.hpp"
+#include "StateHistory.hpp"
+#include "Network.hpp"
+#include "NetGame.hpp"
+#include "SnapshotServer.hpp"
+#include "EmbeddedShaders.hpp"
 
 using namespace glm;
 
@@ -57,27 +75,26 @@ constexpr float BG_RED     = 0.1922f,
                 BG_BLUE    = 0.549f,
                 BG_OPACITY = 1.0f;
 
+// The 10 x 7.5 unit view at the tiles' 18 pixels per unit
+constexpr int NATIVE_WIDTH  = 180,
+              NATIVE_HEIGHT = 135;
+
 constexpr int VIEWPORT_X = 0,
               VIEWPORT_Y = 0,
               VIEWPORT_WIDTH  = WINDOW_WIDTH,
               VIEWPORT_HEIGHT = WINDOW_HEIGHT;
 
-constexpr char V_SHADER_PATH[] = "shaders/vertex_textured.glsl",
-               F_SHADER_PATH[] = "shaders/fragment_textured.glsl";
+// Where SDL_GetPrefPath puts per-user files, like the shader cache
+constexpr char PREF_ORG[] = "ctg",
+               PREF_APP[] = "Platformer";
 
 constexpr float MILLISECONDS_IN_SECOND = 1000.0f;
  
 constexpr char  SPRITESHEET_FILEPATH[]  = "tilemap-characters_packed.png",
                 FONTSHEET_FILEPATH[]    = "font1.png",
-                MAP_TILESET_FILEPATH[]  = "tilemap_packed.png",
-                BGM_FILEPATH[]          = "Sergio_music.mp3",
-                JUMP_SFX_FILEPATH[]     = "jump.wav";
+                MAP_TILESET_FILEPATH[]  = "tilemap_packed.png";
 
-constexpr int   LOOP_FOREVER    = -1,
-                PLAY_ONCE       = 0,
-                NEXT_CHNL       = -1,
-                MUTE_VOL        =  0,
-                ALL_SFX_CHN     = -1;
+constexpr int   LOOP_FOREVER    = -1;
 
 constexpr GLint NUMBER_OF_TEXTURES = 1,
                 LEVEL_OF_DETAIL    = 0,
@@ -87,24 +104,40 @@ constexpr int FONTBANK_SIZE = 16;
 
 constexpr int   CD_QUAL_FREQ    = 44100,  // compact disk (CD) quality frequency
                 AUDIO_CHAN_AMT  = 2,
-                AUDIO_BUFF_SIZE = 4096;
+                AUDIO_BUFF_SIZE = 4096;   // SDL_mixer's, about 93 ms
+constexpr int   DEFAULT_MIXER_BUFFER_SIZE = 512,  // our mixer's, about 12 ms
+                MIN_MIXER_BUFFER_SIZE     = 64,
+                MAX_MIXER_BUFFER_SIZE     = 4096;
 
-/* ----- VARIABLES ----- */
+// The simulation rate can be 30, 60 or 120 Hz (--sim-hz); rendering interpolates
+// between the last two steps, so the display rate doesn't have to match it
+constexpr int   DEFAULT_SIM_HZ      = 60,
+                MAX_CATCH_UP_STEPS  = 8;    // per frame, so a slow frame can't snowball
+
+constexpr float UPLOAD_BUDGET_MS = 4.0f;  // main-thread upload work allowed per frame
+
+constexpr int DEFAULT_HEADLESS_TICKS = 10000;
 
-Scene   *g_current_scene;
-Level1  *g_level_1;
-Level2  *g_level_2;
-Level3  *g_level_3;
-Start   *g_start;
+constexpr int REWIND_SECONDS = 10;    // how far back holding R can go
+
+constexpr int NET_LOOPBACK_PLAYER = 1;  // the in-process peer --net-loopback plays against
+
+// What each --server-loopback spectator looks at: one follows the player, the rest
+// sit at fixed points along the level
+constexpr float SPECTATOR_VIEW_WIDTH = 10.0f;
+
+/* ----- VARIABLES ----- */
 
-Scene *scenes[4];
+// Scenes are built when they're first needed and released once they've been left;
+// see SceneRegistry
+Scene *g_current_scene;
 int scene_index;
 bool next_scene;
 
 int *g_lives;
 
 SDL_Window* g_display_window = nullptr;
-AppStatus g_app_status = RUNNING;
+std::atomic<AppStatus> g_app_status(RUNNING);
 
 ShaderProgram g_shader_program = ShaderProgram();
 
@@ -112,8 +145,12 @@ mat4    g_view_matrix,
         g_projection_matrix;
 
 float g_time_accumulator = 0.0f;
+float g_fixed_timestep = 1.0f / DEFAULT_SIM_HZ;
 
 GLuint g_font_texture_id;
+// The font's own texture, just for the loading screen: the one above is a region of
+// the atlas, which doesn't exist until every sheet on it has been decoded
+GLuint g_loading_font_texture_id = 0;
 
 float g_player_speed = 1.0f;  // move 1 unit per second
 
@@ -123,34 +160,346 @@ int g_animation_index;
 
 float g_animation_time = 0.0f;
 
-float g_previous_ticks = 0.0f;
+FramePacer g_frame_pacer;
+PerfOverlay g_perf_overlay;
+PacingMode g_pacing_mode = VSYNC;
+
+// --headless runs the scenes with no window, GL context or audio device
+bool g_headless = false;
+int  g_headless_ticks = DEFAULT_HEADLESS_TICKS;
+// --random-input plays it with random_input from --seed, so a headless run (and a
+// recording of one) actually moves the player
+bool g_random_input = false;
+int  g_first_scene = 0;
+
+// --profile <path> records a Chrome trace of the whole run (see Profiler.hpp)
+std::string g_profile_path;
+
+// --pixel-res / --dynamic-res draw into a low-res target first (see ResolutionMode)
+ResolutionMode g_resolution_mode = FULL_RESOLUTION;
+
+// Sound effects go through SoftwareMixerAudio unless --sdl-mixer asks for the old path
+bool g_use_sdl_mixer = false;
+int  g_mixer_buffer_size = DEFAULT_MIXER_BUFFER_SIZE;
+
+// The simulation runs on its own thread and hands the renderer a RenderSnapshot
+// after each batch of fixed steps; --single-thread does both on the main thread
+bool g_single_thread = false;
+TripleBuffer<RenderSnapshot> g_snapshots;
+std::atomic<bool> g_simulation_running(false);     // until simulation_loop returns
+
+// Filled in by process_input (main thread), taken a step at a time by simulate_step
+InputQueue g_input;
+// W and Enter both jump, but the queue keeps one held bit per action, so it only
+// hears about the two together: let go of one while the other is down and it's still held
+bool g_jump_w_held      = false,
+     g_jump_return_held = false;
+
+// --record <path> writes every step's input; --replay <path> plays it back as fast
+// as it can (without a window under --headless) and checks it ends the same way
+std::string g_record_path,
+            g_replay_path;
+ReplayRecorder g_recorder;
+ReplayPlayer g_replay;
+bool g_replaying = false;
+Uint32 g_seed = 0;      // --seed, or the clock; recordings carry their own
+int g_exit_status = 0;
+
+// The current scene's last REWIND_SECONDS of fixed steps (simulation thread only)
+StateHistory g_history;
+std::vector<Uint8> g_state_blob;
 
+// --net <port> <peer port> <player> plays a two-player game over UDP on this machine;
+// --net-loopback runs both players in this process instead, headless, with random
+// input, and checks they agree. --net-latency/--net-jitter <ms> and --net-loss <%>
+// make the connection worse
+NetGame *g_net = nullptr;
+Transport *g_net_transport = nullptr,
+          *g_net_peer_transport = nullptr;    // the in-process player's end, with --net-loopback
+Uint16  g_net_port      = 0,
+        g_net_peer_port = 0;
+int     g_net_player    = 0;
+bool    g_net_loopback  = false;
+float   g_net_latency_ms = 0.0f,
+        g_net_jitter_ms  = 0.0f,
+        g_net_loss       = 0.0f;
 
+// --serve <port> <client port> sends a spectator snapshots of the game over UDP;
+// --spectate <port> <server port> watches a game like that instead of playing.
+// --server-loopback <n> runs a headless game with n in-process spectators and
+// checks every snapshot they decode (see SnapshotServer)
+SnapshotServer *g_server = nullptr;
+SnapshotClient *g_spectator = nullptr;
+Uint16  g_serve_port            = 0,
+        g_serve_client_port     = 0,
+        g_spectate_port         = 0,
+        g_spectate_server_port  = 0;
+int     g_server_loopback_clients = 0;
+
+// What the last frame could see, so the simulation knows what to capture. Until
+// there's been a frame (or after a scene switch) it captures everything
+const Bounds EVERYTHING = { -1e6f, 1e6f, -1e6f, 1e6f };
+Bounds g_camera_bounds = EVERYTHING;
+std::mutex g_camera_mutex;
+
+
+void parse_arguments(int argc, char* argv[]);
 void initialise();
+#ifndef HEADLESS_BUILD
+void initialise_video();
+void load_shader();
+#endif
+void load_assets();
 void process_input();
+void apply_input(const StepInput &input);
 void update();
+int advance_simulation(float delta_time);
+void simulate_step(Uint64 step_end);
+void simulate_net_step(Uint64 step_end);
+void simulate_spectator_step();
+void check_scene_progress();
+void set_app_status(AppStatus status);
+void capture_snapshot();
 void render();
+void run_single_threaded();
+void run_threaded();
+void simulation_loop();
+void run_headless();
+void run_server();
+void run_replay();
+void run_net_loopback();
+void run_server_loopback();
+StepInput random_input(Uint32 &random, const StepInput &previous);
+void push_random_input(Uint32 &random, StepInput &input);
+Uint64 compute_state_hash();
 void shutdown();
 
-void switch_to_scene(Scene *scene);
+void register_scenes();
+void switch_to_scene(int index);
 
 int main(int argc, char* argv[]) {
+    parse_arguments(argc, argv);
+
+    PROFILE_THREAD("Main");
+    if (not g_profile_path.empty()) Profiler::begin_session(g_profile_path);
+
     initialise();
 
-    while (g_app_status != TERMINATED) {
-        process_input();
-        update();
-        render();
-    }
+    if (g_replaying) run_replay();
+    else if (g_net_loopback) run_net_loopback();
+    else if (g_server_loopback_clients > 0) run_server_loopback();
+    else if (g_headless and g_server) run_server();
+    else if (g_headless) run_headless();
+    else if (g_single_thread) run_single_threaded();
+    else run_threaded();
 
     shutdown();
-    return 0;
+    return g_exit_status;
+}
+
+// --vsync (default), --fps <n> for a capped frame rate, --uncapped to run flat out,
+// --pacing-stats to log frame times every few seconds
+// --sim-hz <30|60|120> for the fixed simulation rate
+// --headless [--ticks <n>] [--random-input] to simulate without a window, --scene <n> to start further in
+// --profile <path> to write a Chrome trace
+// --pixel-res to draw at the art's native resolution, --dynamic-res to scale under load
+// --single-thread to simulate on the main thread between frames
+// --audio-buffer <frames> for the mixer's buffer size, --sdl-mixer to mix with SDL_mixer instead
+// --record <path> to save the run's input, --replay <path> to play one back, --seed <n>
+// --net <port> <peer port> <0|1> for two players over UDP, --net-loopback to test that in-process,
+// --net-latency <ms>, --net-jitter <ms> and --net-loss <percent> to simulate a bad connection
+// --serve <port> <client port> to let a spectator watch (with --headless, until it's killed),
+// --spectate <port> <server port> to be one,
+// --server-loopback <clients> to test that in-process
+void parse_arguments(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        
+        if (arg == "--vsync") g_pacing_mode = VSYNC;
+        else if (arg == "--uncapped") g_pacing_mode = UNCAPPED;
+        else if (arg == "--fps" and i + 1 < argc) {
+            g_pacing_mode = CAPPED;
+            g_frame_pacer.set_target_fps(atoi(argv[++i]));
+        }
+        else if (arg == "--sim-hz" and i + 1 < argc) {
+            int sim_hz = atoi(argv[++i]);
+            if (sim_hz == 30 or sim_hz == 60 or sim_hz == 120)
+                g_fixed_timestep = 1.0f / sim_hz;
+            else LOG("Unsupported simulation rate " << sim_hz << " Hz, using " << DEFAULT_SIM_HZ << ".");
+        }
+        else if (arg == "--headless") g_headless = true;
+        else if (arg == "--single-thread") g_single_thread = true;
+        else if (arg == "--sdl-mixer") g_use_sdl_mixer = true;
+        else if (arg == "--record" and i + 1 < argc) g_record_path = argv[++i];
+        else if (arg == "--replay" and i + 1 < argc) g_replay_path = argv[++i];
+        else if (arg == "--seed" and i + 1 < argc) g_seed = (Uint32) strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--audio-buffer" and i + 1 < argc) {
+            g_mixer_buffer_size = atoi(argv[++i]);
+            if (g_mixer_buffer_size < MIN_MIXER_BUFFER_SIZE or g_mixer_buffer_size > MAX_MIXER_BUFFER_SIZE)
+                g_mixer_buffer_size = DEFAULT_MIXER_BUFFER_SIZE;
+        }
+        else if (arg == "--pixel-res") g_resolution_mode = PIXEL_PERFECT;
+        else if (arg == "--dynamic-res") g_resolution_mode = DYNAMIC_RESOLUTION;
+        else if (arg == "--profile" and i + 1 < argc) g_profile_path = argv[++i];
+        else if (arg == "--pacing-stats") g_frame_pacer.set_log_stats(true);
+        else if (arg == "--ticks" and i + 1 < argc) g_headless_ticks = atoi(argv[++i]);
+        else if (arg == "--random-input") g_random_input = true;
+        else if (arg == "--net" and i + 3 < argc) {
+            g_net_port      = (Uint16) atoi(argv[++i]);
+            g_net_peer_port = (Uint16) atoi(argv[++i]);
+            g_net_player    = atoi(argv[++i]) == 1 ? 1 : 0;
+        }
+        else if (arg == "--net-loopback") g_net_loopback = g_headless = true;
+        else if (arg == "--net-latency" and i + 1 < argc) g_net_latency_ms = (float) atof(argv[++i]);
+        else if (arg == "--net-jitter" and i + 1 < argc) g_net_jitter_ms = (float) atof(argv[++i]);
+        else if (arg == "--net-loss" and i + 1 < argc) g_net_loss = (float) atof(argv[++i]) / 100.0f;
+        else if (arg == "--serve" and i + 2 < argc) {
+            g_serve_port        = (Uint16) atoi(argv[++i]);
+            g_serve_client_port = (Uint16) atoi(argv[++i]);
+        }
+        else if (arg == "--spectate" and i + 2 < argc) {
+            g_spectate_port         = (Uint16) atoi(argv[++i]);
+            g_spectate_server_port  = (Uint16) atoi(argv[++i]);
+        }
+        else if (arg == "--server-loopback" and i + 1 < argc) {
+            g_server_loopback_clients = std::max(1, atoi(argv[++i]));
+            g_headless = true;
+        }
+        else if (arg == "--scene" and i + 1 < argc) {
+            g_first_scene = atoi(argv[++i]);
+            if (g_first_scene < 0) g_first_scene = 0;
+        }
+    }
 }
 
 void initialise() {
+    /* ----- REPLAY ----- */
+    // A recording decides where the run starts and how fast it steps
+    if (not g_replay_path.empty()) {
+        g_replaying = g_replay.load(g_replay_path);
+        if (g_replaying) {
+            const ReplayHeader &header = g_replay.get_header();
+            g_first_scene    = header.first_scene;
+            g_fixed_timestep = 1.0f / header.sim_hz;
+            g_seed           = header.seed;
+        }
+    }
+    if (g_seed == 0) g_seed = (Uint32) time(nullptr);
+    srand(g_seed);
+    
     /* ----- GENERAL SET-UP ----- */
-    SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO);
+#ifdef HEADLESS_BUILD
+    // Built without GL or the mixers (see CMakeLists.txt), so there's nothing else to run with
+    g_headless = true;
+#endif
+    if (g_headless) {
+        // A server keeps going until it's told to stop, which SDL hears as SDL_QUIT
+        SDL_Init(g_serve_port != 0 ? SDL_INIT_EVENTS : 0);
+        Renderer::set(new NullRenderer());
+        Audio::set(new NullAudio());
+    }
+#ifndef HEADLESS_BUILD
+    else {
+        SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO);
+        initialise_video();
+        Renderer::set(new GLRenderer(g_display_window));
+        // Compiled into the binary, so this doesn't have to wait for the loader
+        load_shader();
+        if (g_use_sdl_mixer) Audio::set(new MixerAudio(CD_QUAL_FREQ, AUDIO_CHAN_AMT, AUDIO_BUFF_SIZE));
+        else Audio::set(new SoftwareMixerAudio(CD_QUAL_FREQ, g_mixer_buffer_size));
+    }
+#endif
+    
+    /* ----- AUDIO SET-UP ----- */
+    // Opened once, up front, since the loader decodes sounds into the device's format
+    Audio::get()->open();
+    
+    /* ----- ASSET REQUESTS ----- */
+    // Small enough to load right here, so the loading screen has text from its first frame
+    if (not g_headless) g_loading_font_texture_id = Utility::load_texture(FONTSHEET_FILEPATH);
+    AssetLoader::start();
+    // Every sheet on one page, so the map, sprites and text never switch textures
+    AssetLoader::request_atlas({ Scene::MAP_TILESET_FILEPATH, Scene::SPRITESHEET_FILEPATH,
+                                 Scene::FONTSHEET_FILEPATH, Scene::BACKGROUNDS_FILEPATH });
+    Scene::request_textures();
+    if (not g_headless) {
+        AssetLoader::request_texture(FONTSHEET_FILEPATH, &g_font_texture_id);
+    }
+    
+    /* ----- SCENE SET-UP ----- */
+    g_lives = new int;
+    *g_lives = 3;
+    register_scenes();
+    if (g_first_scene >= SceneRegistry::get_count()) g_first_scene = START_SCENE;
+    
+    // Every sound and song, shared by all the scenes
+    AudioManager::load_bank();
+    
+    if (g_headless) AssetLoader::finish();
+    else load_assets();
+    
+    g_history.set_capacity(REWIND_SECONDS * (int) roundf(1.0f / g_fixed_timestep));
+    
+    /* ----- NETWORK SET-UP ----- */
+    // A replay has everything it needs already
+    if (not g_replaying and (g_net_port != 0 or g_net_loopback)) {
+        Transport *ours, *theirs = nullptr;
+        if (g_net_loopback) {
+            LoopbackTransport *first, *second;
+            LoopbackTransport::create_pair(&first, &second);
+            ours = first;
+            theirs = second;
+            g_net_player = 1 - NET_LOOPBACK_PLAYER;
+        } else ours = new UdpTransport(g_net_port, g_net_peer_port);
+        
+        if (g_net_latency_ms > 0.0f or g_net_jitter_ms > 0.0f or g_net_loss > 0.0f) {
+            ours = new LaggyTransport(ours, g_net_latency_ms, g_net_jitter_ms, g_net_loss, g_seed);
+            if (theirs) theirs = new LaggyTransport(theirs, g_net_latency_ms, g_net_jitter_ms, g_net_loss, g_seed + 1);
+        }
+        g_net_transport = ours;
+        g_net_peer_transport = theirs;
+        
+        // The title screen is one player's
+        if (g_first_scene == START_SCENE) g_first_scene = START_SCENE + 1;
+        g_net = new NetGame(ours, g_net_player, g_fixed_timestep, true);
+    }
+    
+    /* ----- SPECTATOR SET-UP ----- */
+    // The server is the one place the game runs, so it doesn't mix with rollback
+    if (not g_replaying and not g_net) {
+        if (g_serve_port != 0 or g_server_loopback_clients > 0) {
+            g_server = new SnapshotServer();
+            // --server-loopback adds its own clients
+            if (g_serve_port != 0) g_server->add_client(new UdpTransport(g_serve_port, g_serve_client_port));
+            // Nobody's there to get past the title screen
+            if ((g_server_loopback_clients > 0 or g_headless) and g_first_scene == START_SCENE)
+                g_first_scene = START_SCENE + 1;
+        }
+        else if (g_spectate_port != 0)
+            g_spectator = new SnapshotClient(new UdpTransport(g_spectate_port, g_spectate_server_port));
+    }
+    
+    // The first scene is the only one built before we start
+    switch_to_scene(g_first_scene);
+    // So the first frame has something to draw
+    if (not g_headless) capture_snapshot();
     
+    if (not g_record_path.empty() and not g_replaying and not g_net and not g_spectator)
+        g_recorder.begin(g_record_path, (int) roundf(1.0f / g_fixed_timestep), scene_index, g_seed);
+    
+    /* ----- MUSIC SET-UP ----- */
+    AudioManager::play_music(MUSIC_BGM, LOOP_FOREVER);
+    Audio::get()->set_music_volume(0.25f);
+    
+    /* ----- FRAME PACING ----- */
+    if (not g_headless) g_frame_pacer.set_mode(g_pacing_mode);
+    
+    Renderer::get()->set_resolution_mode(g_resolution_mode, NATIVE_WIDTH, NATIVE_HEIGHT,
+                                         MILLISECONDS_IN_SECOND / g_frame_pacer.get_target_fps());
+}
+
+#ifndef HEADLESS_BUILD
+void initialise_video() {
     g_display_window = SDL_CreateWindow("Platformer",
                                       SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
                                       WINDOW_WIDTH, WINDOW_HEIGHT,
@@ -170,49 +519,76 @@ void initialise() {
     
     /* ----- VIDEO SET-UP ----- */
     glViewport(VIEWPORT_X, VIEWPORT_Y, VIEWPORT_WIDTH, VIEWPORT_HEIGHT);
+    
+    glClearColor(BG_RED, BG_BLUE, BG_GREEN, BG_OPACITY);
+    
+    /* ----- BLENDING ----- */
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
 
-    g_shader_program.Load(V_SHADER_PATH, F_SHADER_PATH);
+void load_shader() {
+    PROFILE_FUNCTION();
+    Uint64 start_counter = SDL_GetPerformanceCounter();
+    
+    // Linking from source is slow on software GL, so reuse last run's binary if we can
+    std::string cache_directory;
+    if (char *pref_path = SDL_GetPrefPath(PREF_ORG, PREF_APP)) {
+        cache_directory = pref_path;
+        SDL_free(pref_path);
+    }
+    g_shader_program.LoadCached(EmbeddedShaders::VERTEX_TEXTURED, EmbeddedShaders::FRAGMENT_TEXTURED,
+                                cache_directory);
+    
+    float load_ms = (float) (SDL_GetPerformanceCounter() - start_counter) * MILLISECONDS_IN_SECOND
+                    / (float) SDL_GetPerformanceFrequency();
+    LOG("Shader program " << (g_shader_program.loadedFromCache ? "loaded from cache" : "compiled")
+        << " in " << load_ms << " ms.");
     
     g_view_matrix       = mat4(1.0f);
     g_projection_matrix = ortho(-5.0f, 5.0f, -3.75f, 3.75f, -1.0f, 1.0f);
 
-    g_shader_program.SetProjectionMatrix(g_projection_matrix);
-    g_shader_program.SetViewMatrix(g_view_matrix);
+    Renderer::get()->set_projection_matrix(&g_shader_program, g_projection_matrix);
+    Renderer::get()->set_view_matrix(&g_shader_program, g_view_matrix);
 
     glUseProgram(g_shader_program.programID);
+}
+#endif
+
+// Keeps the window drawing while the loader's workers decode everything, uploading
+// a frame's budget of finished assets at a time and showing the progress so far
+void load_assets() {
+    Uint64 start_counter = SDL_GetPerformanceCounter();
     
-    glClearColor(BG_RED, BG_BLUE, BG_GREEN, BG_OPACITY);
-    
-    g_font_texture_id = Utility::load_texture(FONTSHEET_FILEPATH);
-    
-    /* ----- SCENE SET-UP ----- */
-    g_lives = new int;
-    *g_lives = 3;
-    g_level_1 = new Level1();
-    g_level_2 = new Level2();
-    g_level_3 = new Level3();
-    g_start = new Start();
-    scene_index = 0;
-    scenes[0] = g_start;
-    scenes[1] = g_level_1;
-    scenes[2] = g_level_2;
-    scenes[3] = g_level_3;
-    switch_to_scene(scenes[scene_index]);
-    
-    /* ----- MUSIC SET-UP ----- */
-    g_current_scene->m_game_state.bgm = Mix_LoadMUS(BGM_FILEPATH);
-    Mix_PlayMusic(g_current_scene->m_game_state.bgm, LOOP_FOREVER);
-    Mix_VolumeMusic(MIX_MAX_VOLUME / 4.0f);
+    while (true) {
+        AssetLoader::pump_uploads(UPLOAD_BUDGET_MS);
+        SDL_PumpEvents();
+        
+        if (AssetLoader::is_done()) break;
+        
+        Renderer::get()->clear();
+        if (g_loading_font_texture_id != 0) {
+            int percent = (int) (AssetLoader::get_progress() * 100.0f);
+            Utility::draw_text(&g_shader_program, g_loading_font_texture_id,
+                               "Loading " + std::to_string(percent) + "%",
+                               0.3f, 0.03f, vec3(-1.5f, 0.0f, 0.0f));
+        }
+        Renderer::get()->present();
+    }
+    // Everything from here on draws text from the atlas
+    Renderer::get()->delete_texture(g_loading_font_texture_id);
+    g_loading_font_texture_id = 0;
     
-    /* ----- BLENDING ----- */
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    float load_ms = (float) (SDL_GetPerformanceCounter() - start_counter) * MILLISECONDS_IN_SECOND
+                    / (float) SDL_GetPerformanceFrequency();
+    LOG("Loaded " << AssetLoader::get_completed_count() << " assets in " << load_ms
+        << " ms on " << AssetLoader::get_worker_count() << " worker(s).");
 }
 
+// Main thread: polls SDL and queues what happened, stamped with when it happened,
+// for the fixed steps to pick up; the player itself is only touched by the simulation
 void process_input() {
-    
-    if (g_current_scene != g_start)
-        g_current_scene->m_game_state.player->set_mov(vec3(0.0f));
+    PROFILE_FUNCTION();
     
     SDL_Event event;
     while (SDL_PollEvent(&event))
@@ -222,141 +598,742 @@ void process_input() {
             case SDL_WINDOWEVENT_CLOSE: g_app_status = TERMINATED; break;
                 
             case SDL_KEYDOWN:
+            case SDL_KEYUP:
+            {
+                if (event.key.repeat) break;
+                bool pressed = event.type == SDL_KEYDOWN;
+                Uint64 timestamp = InputQueue::to_counter(event.key.timestamp);
+                
                 switch (event.key.keysym.sym) {
                     case SDLK_q:
-                        g_app_status = TERMINATED;
+                        if (pressed) g_app_status = TERMINATED;
+                        break;
+                    case SDLK_F3:
+                        if (pressed) g_perf_overlay.toggle();
                         break;
                     case SDLK_SPACE:
-                        if (g_app_status == PAUSED) g_app_status = RUNNING;
-                        else if (g_app_status == RUNNING) g_app_status = PAUSED;
+                    {
+                        // The other player can't be paused
+                        if (not pressed or g_net) break;
+                        // Only flips between the two, in case the simulation just ended the game
+                        AppStatus paused = PAUSED, running = RUNNING;
+                        if (not g_app_status.compare_exchange_strong(paused, RUNNING))
+                            g_app_status.compare_exchange_strong(running, PAUSED);
                         break;
+                    }
                     case SDLK_RETURN:
-                        if (g_current_scene == g_start)
-                            next_scene = true;
+                        g_input.push(ACTION_START, pressed, timestamp);
+                        g_jump_return_held = pressed;
+                        g_input.push(ACTION_JUMP, g_jump_w_held or g_jump_return_held, timestamp);
+                        break;
                     case SDLK_w:
-                        if (g_current_scene != g_start){
-                            if (g_current_scene->m_game_state.player->get_collided_bottom()) {
-                                g_current_scene->m_game_state.player->jump();
-                                Mix_PlayChannel(NEXT_CHNL,
-                                                g_current_scene->m_game_state.jump_sfx,
-                                                PLAY_ONCE);
-                            }
-                        }
+                        g_jump_w_held = pressed;
+                        g_input.push(ACTION_JUMP, g_jump_w_held or g_jump_return_held, timestamp);
+                        break;
+                    case SDLK_a:
+                        g_input.push(ACTION_LEFT, pressed, timestamp);
+                        break;
+                    case SDLK_d:
+                        g_input.push(ACTION_RIGHT, pressed, timestamp);
+                        break;
+                    case SDLK_r:
+                        g_input.push(ACTION_REWIND, pressed, timestamp);
+                        break;
                     default: break;
                 }
+                break;
+            }
             default: break;
         }
     }
     
+    // Anything SDL didn't send an event for (like a key let go while unfocused)
     const Uint8 *key_state = SDL_GetKeyboardState(NULL);
+    Uint64 now = SDL_GetPerformanceCounter();
     
-    if (g_current_scene != g_start){
-        if (key_state[SDL_SCANCODE_A])      g_current_scene->m_game_state.player->move_left();
-        else if (key_state[SDL_SCANCODE_D]) g_current_scene->m_game_state.player->move_right();
-        
-        if (length(g_current_scene->m_game_state.player->get_mov()) > 1.0f)
-                g_current_scene->m_game_state.player->normalize_movement();
+    g_input.sync(ACTION_LEFT,  key_state[SDL_SCANCODE_A], now);
+    g_input.sync(ACTION_RIGHT, key_state[SDL_SCANCODE_D], now);
+    g_jump_w_held      = key_state[SDL_SCANCODE_W];
+    g_jump_return_held = key_state[SDL_SCANCODE_RETURN];
+    g_input.sync(ACTION_JUMP,  g_jump_w_held or g_jump_return_held, now);
+    g_input.sync(ACTION_START, key_state[SDL_SCANCODE_RETURN], now);
+    g_input.sync(ACTION_REWIND, key_state[SDL_SCANCODE_R], now);
+}
+
+void apply_input(const StepInput &input) {
+    if (scene_index == START_SCENE) {
+        if (input.start) next_scene = true;
+        return;
     }
     
+    if (Scene::move_player(g_current_scene->m_game_state.player, input)) AudioManager::play(SFX_JUMP);
 }
 
 void update() {
-    /* DELTA TIME */
-    float ticks = (float) SDL_GetTicks() / MILLISECONDS_IN_SECOND;
-    float delta_time = ticks - g_previous_ticks;
-    g_previous_ticks = ticks;
+    PROFILE_FUNCTION();
+    /* BACKGROUND LOADING */
+    AssetLoader::pump_uploads(UPLOAD_BUDGET_MS);
     
+    if (advance_simulation(g_frame_pacer.get_delta_time()) > 0) capture_snapshot();
+}
+
+// Runs as many fixed steps as delta_time (plus what was left over) covers;
+// returns how many it ran
+int advance_simulation(float delta_time) {
+    /* DELTA TIME */
     delta_time += g_time_accumulator;
     
-    if (delta_time < FIXED_TIMESTEP) {
+    if (delta_time < g_fixed_timestep) {
         g_time_accumulator = delta_time;
-        return;
+        return 0;
     }
-    while (delta_time >= FIXED_TIMESTEP) {
-        // Update whole scene
-        if (g_app_status == RUNNING)
-            g_current_scene->update(FIXED_TIMESTEP);
+    // Where each step ends in real time, so it only takes input from before then
+    Uint64 now       = SDL_GetPerformanceCounter(),
+           frequency = SDL_GetPerformanceFrequency();
+    
+    int steps = 0;
+    while (delta_time >= g_fixed_timestep) {
+        // If we're this far behind, drop the backlog instead of spiralling
+        if (steps == MAX_CATCH_UP_STEPS) {
+            LOG("Dropped " << (int) (delta_time / g_fixed_timestep) << " simulation steps.");
+            delta_time = fmodf(delta_time, g_fixed_timestep);
+            break;
+        }
         
-        if (g_current_scene->m_game_state.player->get_pos().y < -10.0f)
-            g_current_scene->m_game_state.player->kill_off();
+        Uint64 still_to_run = (Uint64) ((delta_time - g_fixed_timestep) * frequency);
+        simulate_step(now - std::min(now, still_to_run));
             
-        delta_time -= FIXED_TIMESTEP;
+        delta_time -= g_fixed_timestep;
+        steps++;
     }
     
     g_time_accumulator = delta_time;
     
+    check_scene_progress();
+    return steps;
+}
+
+void simulate_step(Uint64 step_end) {
+    PROFILE_FUNCTION();
+    if (g_net) {
+        simulate_net_step(step_end);
+        return;
+    }
+    if (g_spectator) {
+        g_input.take_step(step_end);
+        simulate_spectator_step();
+        return;
+    }
+    
+    ReplayTick tick;
+    if (g_replaying) {
+        g_replay.next(tick);
+        // Pausing is the one thing outside the input that changes what a step does
+        AppStatus from = tick.paused ? RUNNING : PAUSED;
+        g_app_status.compare_exchange_strong(from, tick.paused ? PAUSED : RUNNING);
+    } else {
+        tick.input  = g_input.take_step(step_end);
+        tick.paused = g_app_status == PAUSED;
+        g_recorder.record(tick);
+    }
+    apply_input(tick.input);
+    
+    // Update whole scene, or step it back one while R is held
+    if (g_app_status == RUNNING and tick.input.rewind) {
+        PROFILE_SCOPE("StateHistory::rewind");
+        if (g_history.rewind(1, g_state_blob) > 0) g_current_scene->load_state(g_state_blob);
+    } else if (g_app_status == RUNNING) {
+        PROFILE_SCOPE("Scene::update");
+        g_current_scene->update(g_fixed_timestep);
+        g_current_scene->save_state(g_state_blob);
+        g_history.push(g_state_blob);
+    }
+    
+    if (g_current_scene->m_game_state.player->get_pos().y < -10.0f)
+        g_current_scene->m_game_state.player->kill_off();
+    
+    g_current_scene->update_spatial_index();
+    
+    if (g_server) {
+        PROFILE_SCOPE("SnapshotServer::tick");
+        g_server->tick(g_current_scene, scene_index, *g_lives);
+    }
+}
+
+// Nothing runs here: the scene is wherever the server's latest snapshot says,
+// and follows it when it moves on to another level
+void simulate_spectator_step() {
+    Bounds visible;
+    {
+        std::lock_guard<std::mutex> lock(g_camera_mutex);
+        visible = g_camera_bounds;
+    }
+    g_spectator->update(visible);
+    if (not g_spectator->has_snapshot()) return;
+    
+    int server_scene = g_spectator->get_latest().scene;
+    if (server_scene != scene_index and server_scene < SceneRegistry::get_count()) switch_to_scene(server_scene);
+    g_spectator->apply(g_current_scene, g_lives);
+}
+
+// A step for both players, or for neither if the other one has fallen behind. The
+// NetGame decides when the level is over, since both sides have to agree on it
+void simulate_net_step(Uint64 step_end) {
+    StepInput input = g_input.take_step(step_end);
+    if (g_app_status != RUNNING) return;
+    
+    switch (g_net->advance(input)) {
+        case NetGame::LEVEL_CLEARED:
+            if (scene_index + 1 >= SceneRegistry::get_count()) set_app_status(WON);
+            else switch_to_scene(scene_index + 1);
+            break;
+        case NetGame::GAME_LOST:
+            set_app_status(LOST);
+            break;
+        default: break;
+    }
+}
+
+// Quitting wins: the simulation thread must never overwrite TERMINATED
+void set_app_status(AppStatus status) {
+    AppStatus current = g_app_status;
+    while (current != TERMINATED and not g_app_status.compare_exchange_weak(current, status)) { }
+}
+
+void check_scene_progress() {
+    // Networked games only move on when both sides agree; see simulate_net_step.
+    // Spectators go wherever the server does
+    if (g_net or g_spectator) return;
+    
     int enemy_count = 0;
     for (Entity *enemy : g_current_scene->m_game_state.enemies)
         if (enemy->get_active_state())
             enemy_count++;
-    if (*g_lives <= 0) g_app_status = LOST;
+    if (*g_lives <= 0) set_app_status(LOST);
 
     if (enemy_count == 0) next_scene = true;
     
-    g_view_matrix = mat4(1.0f);
-    if (g_current_scene != g_start and
-        g_current_scene->m_game_state.player->get_pos().x > LEFT_EDGE) {
-            g_view_matrix = translate(g_view_matrix,
-                                      vec3(-g_current_scene->m_game_state.player->get_pos().x,
-                                           3.75, 0));
-    } else g_view_matrix = translate(g_view_matrix, vec3(-5, 3.75, 0));
-    
     if (next_scene) {
-        scene_index ++;
-        if (scene_index > 3) {
-            g_app_status = WON;
+        if (scene_index + 1 >= SceneRegistry::get_count()) {
+            set_app_status(WON);
             return;
         } else {
-            switch_to_scene(scenes[scene_index]);
+            switch_to_scene(scene_index + 1);
             next_scene = false;
         }
         
     }
 }
 
+// Simulation thread (or main, with --single-thread): copies out what the next
+// frames need to draw and hands it over
+void capture_snapshot() {
+    PROFILE_FUNCTION();
+    
+    Bounds visible;
+    {
+        std::lock_guard<std::mutex> lock(g_camera_mutex);
+        visible = g_camera_bounds;
+    }
+    
+    RenderSnapshot &snapshot = g_snapshots.write_slot();
+    g_current_scene->capture(snapshot, visible);
+    // Each side's camera follows its own player
+    if (g_net) {
+        Entity *local = g_net->get_local_entity();
+        snapshot.player_previous_position = local->get_previous_pos();
+        snapshot.player_position          = local->get_pos();
+    }
+    
+    AppStatus status = g_app_status;
+    snapshot.start_screen   = scene_index == START_SCENE;
+    snapshot.show_lives     = not snapshot.start_screen;
+    snapshot.won            = status == WON;
+    snapshot.lost           = status == LOST;
+    snapshot.accumulator    = g_time_accumulator;
+    snapshot.published_at   = SDL_GetPerformanceCounter();
+    
+    g_snapshots.publish();
+}
+
 void render() {
-    g_shader_program.SetViewMatrix(g_view_matrix);
+    PROFILE_FUNCTION();
+    
+    g_snapshots.update();
+    const RenderSnapshot &snapshot = g_snapshots.read();
+    // Anything the simulation has left that this snapshot isn't drawing can go now
+    SceneRegistry::collect(snapshot.scene);
+    
+    // How far we are between the last simulated step and the next one: what was
+    // left over when the snapshot was taken, plus however long ago that was
+    float since_capture = (float) (SDL_GetPerformanceCounter() - snapshot.published_at)
+                          / (float) SDL_GetPerformanceFrequency();
+    float alpha = fminf(1.0f, (snapshot.accumulator + since_capture) / g_fixed_timestep);
+    vec3 player_pos = mix(snapshot.player_previous_position, snapshot.player_position, alpha);
+    
+    g_view_matrix = mat4(1.0f);
+    if (not snapshot.start_screen and player_pos.x > LEFT_EDGE) {
+            g_view_matrix = translate(g_view_matrix, vec3(-player_pos.x, 3.75, 0));
+    } else g_view_matrix = translate(g_view_matrix, vec3(-5, 3.75, 0));
+    
+    Renderer::get()->set_view_matrix(&g_shader_program, g_view_matrix);
+    {
+        std::lock_guard<std::mutex> lock(g_camera_mutex);
+        g_camera_bounds = Renderer::get()->get_visible_bounds();
+    }
     
-    glClear(GL_COLOR_BUFFER_BIT);
+    Renderer::get()->clear();
     
-    g_current_scene->render(&g_shader_program);
+    snapshot.scene->render(&g_shader_program, snapshot, alpha);
     
     float curr_pos_x;
-    if (g_current_scene->m_game_state.player->get_pos().x > LEFT_EDGE)
-        curr_pos_x = g_current_scene->m_game_state.player->get_pos().x;
+    if (player_pos.x > LEFT_EDGE)
+        curr_pos_x = player_pos.x;
     else curr_pos_x = 4;
     
-    if (g_current_scene != g_start) {
-        std::string lives_string = "Lives: " + std::to_string(*g_lives);
+    if (snapshot.show_lives) {
+        std::string lives_string = "Lives: " + std::to_string(snapshot.lives);
         Utility::draw_text(&g_shader_program, g_font_texture_id, lives_string,
                            0.3f, 0.0005f, vec3(1.0f, -.5f, 0.0f));
     }
 
-    if (g_app_status == WON)
+    if (snapshot.won)
         Utility::draw_text(&g_shader_program, g_font_texture_id, "You won! :)", 0.3f, 0.03f,
                            vec3(curr_pos_x - 1.0f, -1.5f, 0.0f));
-    else if (g_app_status == LOST)
+    else if (snapshot.lost)
         Utility::draw_text(&g_shader_program, g_font_texture_id, "You lost! :(", 0.3f, 0.03f,
                            vec3(curr_pos_x - 1.0f, -1.5f, 0.0f));
+    
+    if (g_perf_overlay.is_visible()) {
+        Renderer::get()->begin_overlay();
+        g_perf_overlay.render(&g_shader_program, g_font_texture_id, g_view_matrix);
+    }
+
+    {
+        PROFILE_SCOPE("present");
+        Renderer::get()->present();
+    }
+}
+
+void run_single_threaded() {
+    while (g_app_status != TERMINATED) {
+        PROFILE_SCOPE("frame");
+        g_frame_pacer.begin_frame();
+        Renderer::get()->begin_frame();
+        process_input();
+        update();
+        render();
+        g_perf_overlay.add_frame(g_frame_pacer.get_delta_time() * MILLISECONDS_IN_SECOND,
+                                 Renderer::get()->get_stats());
+        g_perf_overlay.set_input_latency(g_input.get_latency());
+        g_frame_pacer.end_frame();
+    }
+}
+
+// SDL wants events and GL on the thread that made the window, so it's the
+// simulation that moves off the main thread; the two only meet at the input,
+// the snapshots and the camera bounds
+void run_threaded() {
+    g_simulation_running = true;
+    std::thread simulation(simulation_loop);
+    
+    while (g_app_status != TERMINATED) {
+        PROFILE_SCOPE("frame");
+        g_frame_pacer.begin_frame();
+        Renderer::get()->begin_frame();
+        // Scenes built in the background only become ready once this runs
+        AssetLoader::pump_uploads(UPLOAD_BUDGET_MS);
+        process_input();
+        render();
+        g_perf_overlay.add_frame(g_frame_pacer.get_delta_time() * MILLISECONDS_IN_SECOND,
+                                 Renderer::get()->get_stats());
+        g_perf_overlay.set_input_latency(g_input.get_latency());
+        g_frame_pacer.end_frame();
+    }
+    
+    // It may be switching to a scene that only becomes ready through the uploads,
+    // so keep them going until it's out
+    while (g_simulation_running)
+        if (AssetLoader::pump_uploads(UPLOAD_BUDGET_MS) == 0) SDL_Delay(1);
+    simulation.join();
+}
+
+// Fixed steps on their own clock, independent of how fast frames are going
+void simulation_loop() {
+    PROFILE_THREAD("Simulation");
+    
+    Uint64 frequency = SDL_GetPerformanceFrequency(),
+           previous  = SDL_GetPerformanceCounter();
+    
+    while (g_app_status != TERMINATED) {
+        Uint64 now = SDL_GetPerformanceCounter();
+        float delta_time = (float) (now - previous) / (float) frequency;
+        previous = now;
+        
+        if (advance_simulation(delta_time) > 0) capture_snapshot();
+        else SDL_Delay(1);
+    }
+    g_simulation_running = false;
+}
+
+// Pure simulation: fixed steps back to back, as fast as the CPU allows
+void run_headless() {
+    Uint64 start_counter = SDL_GetPerformanceCounter();
+    Uint32 random = g_seed | 1;
+    StepInput input;
+    
+    int ticks = 0;
+    while (ticks < g_headless_ticks and g_app_status == RUNNING) {
+        PROFILE_SCOPE("tick");
+        AssetLoader::pump_uploads(UPLOAD_BUDGET_MS);
+        if (g_random_input) push_random_input(random, input);
+        simulate_step(SDL_GetPerformanceCounter());
+        check_scene_progress();
+        SceneRegistry::collect(nullptr);
+        ticks++;
+    }
+    
+    float seconds = (float) (SDL_GetPerformanceCounter() - start_counter)
+                    / (float) SDL_GetPerformanceFrequency();
+    LOG("Headless: " << ticks << " ticks in " << seconds * MILLISECONDS_IN_SECOND << " ms ("
+        << (int) (ticks / seconds) << " ticks/s), ended on scene " << scene_index
+        << " with " << *g_lives << " lives.");
+}
+
+// --serve with --headless: the game on the real clock, as simulation_loop runs it,
+// with no window and no tick limit, until SIGINT or SIGTERM
+void run_server() {
+    LOG("Serving spectators on port " << g_serve_port << ".");
+    Uint64 frequency = SDL_GetPerformanceFrequency(),
+           start     = SDL_GetPerformanceCounter(),
+           previous  = start;
+    int ticks = 0;
+    
+    while (g_app_status != TERMINATED) {
+        SDL_Event event;
+        while (SDL_PollEvent(&event))
+            if (event.type == SDL_QUIT) g_app_status = TERMINATED;
+        
+        AssetLoader::pump_uploads(UPLOAD_BUDGET_MS);
+        Uint64 now = SDL_GetPerformanceCounter();
+        float delta_time = (float) (now - previous) / (float) frequency;
+        previous = now;
+        
+        int steps = advance_simulation(delta_time);
+        if (steps > 0) {
+            SceneRegistry::collect(nullptr);
+            ticks += steps;
+        }
+        else SDL_Delay(1);
+    }
+    
+    float seconds = (float) (SDL_GetPerformanceCounter() - start) / (float) frequency;
+    LOG("Server: " << ticks << " ticks in " << seconds << " s, ended on scene " << scene_index
+        << " with " << *g_lives << " lives.");
+}
+
+// Every recorded tick back to back, and a check that they end where they did before.
+// Without --headless it draws after each step, but still doesn't wait for anything
+void run_replay() {
+    const ReplayHeader &header = g_replay.get_header();
+    LOG("Replaying " << header.tick_count << " ticks at " << header.sim_hz << " Hz from scene "
+        << header.first_scene << ", seed " << header.seed << ".");
+    Uint64 start_counter = SDL_GetPerformanceCounter();
+    
+    while (g_replay.get_ticks_played() < header.tick_count and g_app_status != TERMINATED) {
+        PROFILE_SCOPE("tick");
+        AssetLoader::pump_uploads(UPLOAD_BUDGET_MS);
+        simulate_step(SDL_GetPerformanceCounter());
+        check_scene_progress();
+        
+        if (g_headless) SceneRegistry::collect(nullptr);
+        else {
+            Renderer::get()->begin_frame();
+            // Only for quitting: the recording has the input, and nothing here would
+            // ever take key presses back out of g_input
+            SDL_Event event;
+            while (SDL_PollEvent(&event))
+                if (event.type == SDL_QUIT or (event.type == SDL_KEYDOWN and event.key.keysym.sym == SDLK_q))
+                    g_app_status = TERMINATED;
+            capture_snapshot();
+            render();
+        }
+    }
+    
+    float seconds = (float) (SDL_GetPerformanceCounter() - start_counter)
+                    / (float) SDL_GetPerformanceFrequency();
+    Uint32 ticks = g_replay.get_ticks_played();
+    Uint64 hash = compute_state_hash();
+    bool matches = ticks == header.tick_count and hash == header.final_hash;
+    
+    LOG("Replay: " << ticks << " ticks in " << seconds * MILLISECONDS_IN_SECOND << " ms ("
+        << (int) (ticks / seconds) << " ticks/s), final state " << std::hex << hash << ", recorded "
+        << header.final_hash << std::dec << (matches ? " - matches." : " - DIFFERS."));
+    if (not matches) g_exit_status = 1;
+}
+
+// Holds a direction for a while and jumps now and then (xorshift32, so each
+// player's input is the same every run for a given --seed)
+StepInput random_input(Uint32 &random, const StepInput &previous) {
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    
+    StepInput input = previous;
+    input.jump = random % 40 == 0;
+    if ((random >> 8) % 30 == 0) {
+        int direction = (random >> 16) % 3;
+        input.left  = direction == 1;
+        input.right = direction == 2;
+    }
+    return input;
+}
+
+// The next random_input, queued as key presses for a step nobody is playing
+void push_random_input(Uint32 &random, StepInput &input) {
+    Uint64 now = SDL_GetPerformanceCounter();
+    input = random_input(random, input);
+    g_input.push(ACTION_LEFT, input.left, now);
+    g_input.push(ACTION_RIGHT, input.right, now);
+    if (input.jump) {
+        g_input.push(ACTION_JUMP, true, now);
+        g_input.push(ACTION_JUMP, false, now);
+    }
+}
+
+// Both players in this process, over a LoopbackTransport (and a LaggyTransport, if
+// asked for, on the simulated clock), stepping in turn as fast as they can until a
+// level ends. Then the last step both sides have confirmed has to match exactly
+void run_net_loopback() {
+    int peer_lives = *g_lives;
+    Scene *peer_scene = SceneRegistry::create(scene_index);
+    peer_scene->wait_until_ready();
+    peer_scene->set_lives(&peer_lives);
+    NetGame peer(g_net_peer_transport, NET_LOOPBACK_PLAYER, g_fixed_timestep, false);
+    peer.set_scene(peer_scene);
+    
+    NetGame *sides[RollbackSession::PLAYER_COUNT];
+    sides[g_net_player]         = g_net;
+    sides[NET_LOOPBACK_PLAYER]  = &peer;
+    LaggyTransport *lag[] = { dynamic_cast<LaggyTransport*>(g_net_transport),
+                              dynamic_cast<LaggyTransport*>(g_net_peer_transport) };
+    
+    Uint32 random[RollbackSession::PLAYER_COUNT] = { g_seed | 1, (g_seed * 2654435761u) | 1 };
+    StepInput inputs[RollbackSession::PLAYER_COUNT];
+    float step_ms = g_fixed_timestep * MILLISECONDS_IN_SECOND;
+    Uint64 start_counter = SDL_GetPerformanceCounter();
+    
+    int ticks = 0;
+    bool level_over = false;
+    while (ticks < g_headless_ticks and not level_over) {
+        PROFILE_SCOPE("tick");
+        for (int player = 0; player < RollbackSession::PLAYER_COUNT; player++) {
+            inputs[player] = random_input(random[player], inputs[player]);
+            if (sides[player]->advance(inputs[player]) > NetGame::WAITING) level_over = true;
+        }
+        for (LaggyTransport *transport : lag)
+            if (transport) transport->advance_clock(step_ms);
+        ticks++;
+    }
+    
+    float seconds = (float) (SDL_GetPerformanceCounter() - start_counter)
+                    / (float) SDL_GetPerformanceFrequency();
+    int frame = std::min(g_net->get_session().get_confirmed_frame(), peer.get_session().get_confirmed_frame());
+    std::vector<Uint8> ours, theirs;
+    bool in_sync = g_net->get_state(frame, ours) and peer.get_state(frame, theirs) and ours == theirs;
+    
+    RollbackStats stats = peer.get_session().get_stats();
+    LOG("Net loopback: " << ticks << " ticks in " << seconds * MILLISECONDS_IN_SECOND << " ms, other side "
+        << stats.rollbacks << " rollbacks re-ran " << stats.resimulated << " steps (deepest "
+        << stats.deepest << ", slowest " << stats.peak_resimulate_ms << " ms), waited "
+        << stats.stalls << " ticks.");
+    LOG("Both sides at frame " << frame << ": " << (in_sync ? "in sync" : "OUT OF SYNC")
+        << (level_over ? ", level over." : "."));
+    if (not in_sync) g_exit_status = 1;
+    
+    delete peer_scene;
+}
 
-    SDL_GL_SwapWindow(g_display_window);
+// A headless game with random input, served to in-process spectators over
+// LoopbackTransports (and LaggyTransports, with --net-latency and friends). Every
+// snapshot a spectator decodes has to match what the server sent it exactly
+void run_server_loopback() {
+    int client_count = g_server_loopback_clients;
+    std::vector<SnapshotClient*> clients;
+    std::vector<LaggyTransport*> lag;
+    bool laggy = g_net_latency_ms > 0.0f or g_net_jitter_ms > 0.0f or g_net_loss > 0.0f;
+    for (int i = 0; i < client_count; i++) {
+        LoopbackTransport *server_end, *client_end;
+        LoopbackTransport::create_pair(&server_end, &client_end);
+        Transport *ours = server_end, *theirs = client_end;
+        if (laggy) {
+            LaggyTransport *a = new LaggyTransport(ours, g_net_latency_ms, g_net_jitter_ms, g_net_loss, g_seed + 2 * i),
+                           *b = new LaggyTransport(theirs, g_net_latency_ms, g_net_jitter_ms, g_net_loss, g_seed + 2 * i + 1);
+            lag.push_back(a);
+            lag.push_back(b);
+            ours = a;
+            theirs = b;
+        }
+        g_server->add_client(ours);
+        clients.push_back(new SnapshotClient(theirs));
+    }
+    // Each spectator's own copy of whatever level the server's on
+    std::vector<Scene*> client_scenes(client_count, nullptr);
+    std::vector<int> client_scene_index(client_count, -1),
+                     client_lives(client_count, 0);
+    
+    Uint32 random = g_seed | 1;
+    StepInput input;
+    float step_ms = g_fixed_timestep * MILLISECONDS_IN_SECOND;
+    int mismatches = 0;
+    Uint64 start_counter = SDL_GetPerformanceCounter();
+    
+    int ticks = 0;
+    while (ticks < g_headless_ticks and g_app_status == RUNNING) {
+        PROFILE_SCOPE("tick");
+        AssetLoader::pump_uploads(UPLOAD_BUDGET_MS);
+        
+        push_random_input(random, input);
+        simulate_step(SDL_GetPerformanceCounter());
+        
+        Map *map = g_current_scene->m_game_state.map;
+        float player_x = g_current_scene->m_game_state.player->get_pos().x,
+              span     = std::max(0.0f, map->get_right_bound() - map->get_left_bound() - SPECTATOR_VIEW_WIDTH);
+        for (int i = 0; i < client_count; i++) {
+            float left = i == 0 ? player_x - SPECTATOR_VIEW_WIDTH / 2.0f
+                                : map->get_left_bound() + span * (i - 1) / std::max(1, client_count - 2);
+            clients[i]->update({ left, left + SPECTATOR_VIEW_WIDTH, map->get_bottom_bound(), map->get_top_bound() });
+            if (not clients[i]->has_snapshot()) continue;
+            
+            const Snapshot &latest = clients[i]->get_latest();
+            const Snapshot *sent = g_server->get_sent(i, latest.sequence);
+            bool same = sent and sent->scene == latest.scene and sent->lives == latest.lives
+                        and sent->entities.size() == latest.entities.size();
+            for (size_t e = 0; same and e < latest.entities.size(); e++) {
+                const NetEntity &a = sent->entities[e], &b = latest.entities[e];
+                same = a.id == b.id and a.x == b.x and a.y == b.y and a.animation_index == b.animation_index
+                       and a.flags == b.flags;
+            }
+            if (not same) mismatches++;
+            
+            if (latest.scene != client_scene_index[i]) {
+                delete client_scenes[i];
+                client_scenes[i] = SceneRegistry::create(latest.scene);
+                client_scenes[i]->wait_until_ready();
+                client_scenes[i]->set_lives(&client_lives[i]);
+                client_scene_index[i] = latest.scene;
+            }
+            clients[i]->apply(client_scenes[i], &client_lives[i]);
+        }
+        for (LaggyTransport *transport : lag) transport->advance_clock(step_ms);
+        
+        check_scene_progress();
+        SceneRegistry::collect(nullptr);
+        ticks++;
+    }
+    
+    float seconds = (float) (SDL_GetPerformanceCounter() - start_counter)
+                    / (float) SDL_GetPerformanceFrequency(),
+          game_seconds = ticks * g_fixed_timestep;
+    LOG("Server loopback: " << ticks << " ticks in " << seconds * MILLISECONDS_IN_SECOND << " ms, ended on scene "
+        << scene_index << ", " << mismatches << " snapshots decoded wrong.");
+    for (int i = 0; i < client_count; i++) {
+        ClientStats stats = g_server->get_stats(i);
+        int packets = std::max(1, stats.packets);
+        LOG("  Client " << i << (i == 0 ? " (following)" : "") << ": " << stats.bytes / game_seconds / 1024.0f
+            << " KB/s, " << (float) stats.bytes / packets << " bytes and " << (float) stats.entities / packets
+            << " entities a snapshot, " << stats.total_encode_us / packets << " us to encode (peak "
+            << stats.peak_encode_us << " us).");
+    }
+    if (mismatches > 0) g_exit_status = 1;
+    
+    for (int i = 0; i < client_count; i++) {
+        delete clients[i];
+        delete client_scenes[i];
+    }
+}
+
+// Everything a replay has to reproduce: where we are, lives left, and the entities
+Uint64 compute_state_hash() {
+    // Not g_app_status: quitting overwrites it, and won/lost follow from these anyway
+    Uint64 hash = Replay::HASH_SEED;
+    hash = Replay::hash(hash, &scene_index, sizeof(scene_index));
+    hash = Replay::hash(hash, g_lives, sizeof(*g_lives));
+    return g_current_scene->get_state_hash(hash);
 }
 
 void shutdown() {
     
+    g_recorder.end(compute_state_hash());
+    
+    if (g_net) {
+        RollbackStats net = g_net->get_session().get_stats();
+        LOG("Rollback: " << net.frames << " steps, " << net.rollbacks << " rollbacks re-ran "
+            << net.resimulated << " steps (deepest " << net.deepest << ", slowest "
+            << net.peak_resimulate_ms << " ms), waited " << net.stalls << " ticks for the other player.");
+        delete g_net;
+        delete g_net_transport;
+        delete g_net_peer_transport;
+        g_net = nullptr;
+    }
+    delete g_server;
+    delete g_spectator;
+    g_server = nullptr;
+    g_spectator = nullptr;
+    
+    HistoryStats history = g_history.get_stats();
+    LOG("Rewind: " << history.frames << " steps held in " << history.resident_bytes / 1024.0f
+        << " KB, " << history.average_delta_bytes * roundf(1.0f / g_fixed_timestep) / 1024.0f
+        << " KB/s, " << history.average_push_us << " us a step (peak " << history.peak_push_us
+        << " us).");
+    
+    AudioManager::stop_all();
+    AssetLoader::shutdown();
+    Profiler::end_session();
+    Audio::get()->close();
+    delete Audio::get();
+    delete Renderer::get();
     SDL_Quit();
     
-    delete g_level_1;
-    delete g_level_2;
-    delete g_level_3;
+    // After the loader has stopped, so no worker is still building one
+    SceneRegistry::release_all();
     delete g_lives;
-    delete g_start;
     
     g_current_scene = nullptr;
 }
 
-void switch_to_scene(Scene *scene) {
+void register_scenes() {
+    SceneRegistry::add([] { return (Scene*) new Start(); });
+    SceneRegistry::add([] { return (Scene*) new Level1(); });
+    SceneRegistry::add([] { return (Scene*) new Level2(); });
+    SceneRegistry::add([] { return (Scene*) new Level3(); });
+}
+
+void switch_to_scene(int index) {
+    // The scene has normally been built in the background by now, so this is just a swap
+    Scene *scene = SceneRegistry::get(index);
+    scene->wait_until_ready();
+    
+    // The one we're leaving is done with; the renderer lets go of it a frame or so later
+    if (g_current_scene) SceneRegistry::release(scene_index);
     g_current_scene = scene;
-    g_current_scene->initialise();
+    scene_index = index;
     g_current_scene->set_lives(g_lives);
+    
+    // The old camera bounds are no use in a new map
+    {
+        std::lock_guard<std::mutex> lock(g_camera_mutex);
+        g_camera_bounds = EVERYTHING;
+    }
+    
+    // Rewinding stops at the start of the scene; networked games roll back instead
+    g_history.clear();
+    if (g_net) g_net->set_scene(g_current_scene);
+    else {
+        g_current_scene->save_state(g_state_blob);
+        g_history.push(g_state_blob);
+    }
+    
+    // And start building the one after it while this one plays
+    SceneRegistry::preload(scene_index + 1);
 }
@@ -0,0 +1,37 @@
+#!/bin/sh
+# Turns every shaders/*.glsl into a string constant in EmbeddedShaders.hpp, so the
+# game doesn't have to find and read them at startup. Run by the "Embed Shaders"
+# build phase before compiling; safe to run by hand after editing a shader.
+#
+# usage: embed_shaders.sh [shader dir] [output header]
+
+cd "$(dirname "$0")"
+SHADER_DIR=${1:-SDLProject/shaders}
+OUTPUT=${2:-SDLProject/EmbeddedShaders.hpp}
+TEMP="$OUTPUT.tmp"
+
+{
+    echo "// Generated by embed_shaders.sh from $(basename "$SHADER_DIR")/*.glsl -- edit those, not this"
+    echo "#ifndef EMBEDDEDSHADERS_H"
+    echo "#define EMBEDDEDSHADERS_H"
+    echo ""
+    echo "#pragma once"
+    echo ""
+    echo "namespace EmbeddedShaders {"
+    for shader in "$SHADER_DIR"/*.glsl; do
+        # vertex_textured.glsl -> VERTEX_TEXTURED
+        name=$(basename "$shader" .glsl | tr '[:lower:]-' '[:upper:]_')
+        echo "    constexpr const char $name[] = R\"glsl("
+        cat "$shader"
+        echo ")glsl\";"
+        echo ""
+    done
+    echo "}"
+    echo ""
+    echo "#endif // EMBEDDEDSHADERS_H"
+} > "$TEMP"
+
+# Only touch the header when a shader changed, so nothing rebuilds for no reason
+if cmp -s "$TEMP" "$OUTPUT"; then rm "$TEMP"
+else mv "$TEMP" "$OUTPUT"
+fi